@@ -353,6 +353,19 @@ static void ffmpeg_cleanup(int ret)
 
     hw_device_free_all();
 
+    if (buffer_pool) {
+        BufPoolStats stats;
+
+        bufpool_stats(buffer_pool, &stats);
+        av_log(NULL, do_benchmark ? AV_LOG_INFO : AV_LOG_VERBOSE,
+               "buffer pool: %"PRIu64" hits, %"PRIu64" misses (%.1f%% hit rate), "
+               "peak %zukB\n", stats.nb_hits, stats.nb_misses,
+               stats.nb_hits * 100.0 / FFMAX(stats.nb_hits + stats.nb_misses, 1),
+               stats.peak_bytes / 1024);
+
+        bufpool_free(&buffer_pool);
+    }
+
     av_freep(&filter_nbthreads);
 
     av_freep(&input_files);
@@ -28,6 +28,7 @@
 
 #include "cmdutils.h"
 #include "ffmpeg_sched.h"
+#include "objpool.h"
 #include "sync_queue.h"
 
 #include "libavformat/avformat.h"
@@ -623,6 +624,8 @@ extern int stdin_interaction;
 extern AVIOContext *progress_avio;
 extern float max_error_rate;
 
+extern BufPool *buffer_pool;
+
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
 extern int vstats_version;
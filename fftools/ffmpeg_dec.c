@@ -19,6 +19,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/dict.h"
 #include "libavutil/error.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/log.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
@@ -53,6 +54,10 @@ struct Decoder {
     AVFrame *sub_prev[2];
     AVFrame *sub_heartbeat;
 
+    // frames skipped as requested by the user, more are skipped while the
+    // scheduler is overloaded
+    enum AVDiscard  skip_frame;
+
     Scheduler      *sch;
     unsigned        sch_idx;
 };
@@ -483,6 +488,10 @@ static int packet_decode(InputStream *ist, AVPacket *pkt, AVFrame *frame)
         fd->wallclock[LATENCY_PROBE_DEC_PRE] = av_gettime_relative();
     }
 
+    if (dec->codec_type == AVMEDIA_TYPE_VIDEO)
+        dec->skip_frame = sch_overloaded(d->sch) ?
+                          FFMAX(d->skip_frame, AVDISCARD_NONREF) : d->skip_frame;
+
     ret = avcodec_send_packet(dec, pkt);
     if (ret < 0 && !(ret == AVERROR_EOF && !pkt)) {
         // In particular, we don't expect AVERROR(EAGAIN), because we read all
@@ -707,6 +716,102 @@ finish:
     return (void*)(intptr_t)ret;
 }
 
+static int get_buffer_video(AVCodecContext *s, AVFrame *frame)
+{
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int linesize[4];
+    ptrdiff_t linesize1[4];
+    size_t size[4];
+    int w = frame->width;
+    int h = frame->height;
+    int unaligned, ret;
+
+    // same layout as avcodec_default_get_buffer2()
+    avcodec_align_dimensions2(s, &w, &h, linesize_align);
+
+    do {
+        ret = av_image_fill_linesizes(linesize, frame->format, w);
+        if (ret < 0)
+            return ret;
+        w += w & ~(w - 1);
+
+        unaligned = 0;
+        for (int i = 0; i < 4; i++)
+            unaligned |= linesize[i] % linesize_align[i];
+    } while (unaligned);
+
+    for (int i = 0; i < 4; i++)
+        linesize1[i] = linesize[i];
+    ret = av_image_fill_plane_sizes(size, frame->format, h, linesize1);
+    if (ret < 0)
+        return ret;
+
+    memset(frame->data, 0, sizeof(frame->data));
+    frame->extended_data = frame->data;
+
+    for (int i = 0; i < 4 && size[i]; i++) {
+        frame->buf[i] = bufpool_get(buffer_pool, size[i] + 16 + 64 - 1);
+        if (!frame->buf[i])
+            return AVERROR(ENOMEM);
+
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = linesize[i];
+    }
+
+    return 0;
+}
+
+static int get_buffer_audio(AVCodecContext *s, AVFrame *frame)
+{
+    int planes = av_sample_fmt_is_planar(frame->format) ?
+                 frame->ch_layout.nb_channels : 1;
+    int ret;
+
+    ret = av_samples_get_buffer_size(&frame->linesize[0], frame->ch_layout.nb_channels,
+                                     frame->nb_samples, frame->format, 0);
+    if (ret < 0)
+        return ret;
+
+    frame->extended_data = frame->data;
+
+    for (int i = 0; i < planes; i++) {
+        frame->buf[i] = bufpool_get(buffer_pool, frame->linesize[0]);
+        if (!frame->buf[i])
+            return AVERROR(ENOMEM);
+
+        frame->data[i] = frame->buf[i]->data;
+    }
+
+    return 0;
+}
+
+/* allocate software frames from the buffer pool shared by all the streams */
+static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
+{
+    const AVPixFmtDescriptor *desc;
+    int ret;
+
+    if (!(s->codec->capabilities & AV_CODEC_CAP_DR1) || s->hw_frames_ctx)
+        return avcodec_default_get_buffer2(s, frame, flags);
+
+    if (s->codec_type == AVMEDIA_TYPE_VIDEO) {
+        desc = av_pix_fmt_desc_get(frame->format);
+        if (!desc || desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))
+            return avcodec_default_get_buffer2(s, frame, flags);
+
+        ret = get_buffer_video(s, frame);
+    } else if (s->codec_type == AVMEDIA_TYPE_AUDIO &&
+               frame->ch_layout.nb_channels <= AV_NUM_DATA_POINTERS) {
+        ret = get_buffer_audio(s, frame);
+    } else
+        return avcodec_default_get_buffer2(s, frame, flags);
+
+    if (ret < 0)
+        av_frame_unref(frame);
+
+    return ret;
+}
+
 static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat *pix_fmts)
 {
     InputStream *ist = s->opaque;
@@ -922,6 +1027,8 @@ int dec_open(InputStream *ist, Scheduler *sch, unsigned sch_idx)
 
     ist->dec_ctx->opaque                = ist;
     ist->dec_ctx->get_format            = get_format;
+    if (buffer_pool)
+        ist->dec_ctx->get_buffer2       = get_buffer;
 
     if (ist->dec_ctx->codec_id == AV_CODEC_ID_DVB_SUBTITLE &&
        (ist->decoding_needed & DECODING_FOR_OST)) {
@@ -960,5 +1067,7 @@ int dec_open(InputStream *ist, Scheduler *sch, unsigned sch_idx)
     if (ret < 0)
         return ret;
 
+    d->skip_frame = ist->dec_ctx->skip_frame;
+
     return 0;
 }
@@ -165,6 +165,19 @@ static int set_encoder_id(OutputFile *of, OutputStream *ost)
     return 0;
 }
 
+/* allocate packets from the buffer pool shared by all the streams */
+static int get_encode_buffer(AVCodecContext *s, AVPacket *pkt, int flags)
+{
+    pkt->buf = bufpool_get(buffer_pool, pkt->size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!pkt->buf)
+        return AVERROR(ENOMEM);
+
+    pkt->data = pkt->buf->data;
+    memset(pkt->data + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    return 0;
+}
+
 int enc_open(void *opaque, const AVFrame *frame)
 {
     OutputStream *ost = opaque;
@@ -298,6 +311,9 @@ int enc_open(void *opaque, const AVFrame *frame)
     if (ost->bitexact)
         enc_ctx->flags |= AV_CODEC_FLAG_BITEXACT;
 
+    if (buffer_pool && (enc->capabilities & AV_CODEC_CAP_DR1))
+        enc_ctx->get_encode_buffer = get_encode_buffer;
+
     if (!av_dict_get(ost->encoder_opts, "threads", NULL, 0))
         av_dict_set(&ost->encoder_opts, "threads", "auto", 0);
 
@@ -135,6 +135,28 @@ static void mux_log_debug_ts(OutputStream *ost, const AVPacket *pkt)
            pkt->size, *latency ? latency : "N/A");
 }
 
+static void mux_stats_frame(Muxer *mux, MuxStream *ms, const AVPacket *pkt)
+{
+    static const char * const stages[] = {
+        [LATENCY_PROBE_DEMUX]       = "demux",
+        [LATENCY_PROBE_DEC_PRE]     = "decode_start",
+        [LATENCY_PROBE_DEC_POST]    = "decode_end",
+        [LATENCY_PROBE_FILTER_PRE]  = "filter_start",
+        [LATENCY_PROBE_FILTER_POST] = "filter_end",
+        [LATENCY_PROBE_ENC_PRE]     = "encode_start",
+        [LATENCY_PROBE_ENC_POST]    = "encode_end",
+    };
+    const FrameData *fd;
+
+    if (!pkt->opaque_ref)
+        return;
+    fd = (const FrameData*)pkt->opaque_ref->data;
+
+    sch_stats_frame(mux->sch, mux->sch_idx, ms->sch_idx, pkt->pts,
+                    ms->ost.st->time_base, stages, fd->wallclock,
+                    FF_ARRAY_ELEMS(fd->wallclock));
+}
+
 static int mux_fixup_ts(Muxer *mux, MuxStream *ms, AVPacket *pkt)
 {
     OutputStream *ost = &ms->ost;
@@ -233,6 +255,8 @@ static int write_packet(Muxer *mux, OutputStream *ost, AVPacket *pkt)
     if (ms->stats.io)
         enc_stats_write(ost, &ms->stats, NULL, pkt, frame_num);
 
+    mux_stats_frame(mux, ms, pkt);
+
     ret = av_interleaved_write_frame(s, pkt);
     if (ret < 0) {
         av_log(ost, AV_LOG_ERROR,
@@ -3153,7 +3153,9 @@ int of_open(const OptionsContext *o, const char *filename, Scheduler *sch)
         return err;
     }
 
-    err = setup_sync_queues(mux, oc, o->shortest_buf_duration * AV_TIME_BASE);
+    err = setup_sync_queues(mux, oc, o->shortest_buf_duration >= 0 ?
+                                     o->shortest_buf_duration * AV_TIME_BASE :
+                                     sch_sq_buf_size(mux->sch));
     if (err < 0) {
         av_log(mux, AV_LOG_FATAL, "Error setting up output sync queues\n");
         return err;
@@ -79,6 +79,7 @@ int abort_on_flags    = 0;
 int print_stats       = -1;
 int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
+BufPool *buffer_pool;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
 int vstats_version = 2;
@@ -147,7 +148,7 @@ static void init_options(OptionsContext *o)
     o->thread_queue_size = -1;
     o->input_sync_ref = -1;
     o->find_stream_info = 1;
-    o->shortest_buf_duration = 10.f;
+    o->shortest_buf_duration = -1.f;
 }
 
 static int show_hwaccels(void *optctx, const char *opt, const char *arg)
@@ -604,6 +605,48 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(sch, arg);
 }
 
+static int opt_sched_stats(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    return sch_stats_file(sch, arg);
+}
+
+static int opt_sched_profile(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    enum SchedulerProfile profile;
+
+    if (!strcmp(arg, "balanced"))
+        profile = SCH_PROFILE_BALANCED;
+    else if (!strcmp(arg, "latency"))
+        profile = SCH_PROFILE_LATENCY;
+    else if (!strcmp(arg, "throughput"))
+        profile = SCH_PROFILE_THROUGHPUT;
+    else {
+        av_log(NULL, AV_LOG_ERROR, "Unknown scheduler profile: %s\n", arg);
+        return AVERROR(EINVAL);
+    }
+
+    return sch_profile(sch, profile);
+}
+
+static int opt_buffer_pool(void *optctx, const char *opt, const char *arg)
+{
+    double max_cached;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT64, 0, SIZE_MAX, &max_cached);
+    if (ret < 0)
+        return ret;
+
+    bufpool_free(&buffer_pool);
+    if (!max_cached)
+        return 0;
+
+    buffer_pool = bufpool_alloc(max_cached);
+    return buffer_pool ? 0 : AVERROR(ENOMEM);
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1579,6 +1622,17 @@ const OptionDef options[] = {
     { "timelimit",              OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_timelimit },
         "set max runtime in seconds in CPU user time", "limit" },
+    { "sched_stats",            OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_stats },
+        "write queue, node and per-frame latency statistics as JSON lines to a file", "file" },
+    { "buffer_pool",            OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_buffer_pool },
+        "share decoded frame and encoded packet buffers between all streams, "
+        "keeping up to the given number of idle bytes", "size" },
+    { "sched_profile",          OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_profile },
+        "trade latency for throughput in the scheduling of the transcoding pipeline",
+        "balanced|latency|throughput" },
     { "dump",                   OPT_TYPE_BOOL, OPT_EXPERT,
         { &do_pkt_dump },
         "dump each input packet" },
@@ -22,6 +22,7 @@
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "cmdutils.h"
 #include "ffmpeg_sched.h"
@@ -32,6 +33,7 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
@@ -40,20 +42,79 @@
 #include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 
-// 100 ms
-// FIXME: some other value? make this dynamic?
-#define SCHEDULE_TOLERANCE (100 * 1000)
+// a queue that made both its sender and its receiver wait for more than
+// 1/QUEUE_STALL_DIV of the time since the last adjustment is made deeper
+#define QUEUE_STALL_DIV 50
+
+// with skip_on_overload, output that fell behind real time by more than this
+// many microseconds makes decoders skip frames, until it caught up to half
+// of it again
+#define OVERLOAD_LAG (500 * 1000)
+
+// per-frame statistics not yet written out are dropped beyond this size
+#define STATS_FRAMES_MAX_SIZE (1 << 20)
 
 enum QueueType {
     QUEUE_PACKETS,
     QUEUE_FRAMES,
 };
 
+typedef struct SchProfile {
+    // range of the number of items in the queues between nodes, the queues
+    // start at the minimum and are adjusted within the range based on how
+    // often they stall; all values must be powers of two
+    unsigned            queue_min[2];
+    unsigned            queue_max[2];
+
+    // how far (in microseconds) an output stream may get ahead of the
+    // trailing one before its source is choked
+    int64_t             schedule_tolerance;
+
+    // default maximum duration buffered in sync queues, in microseconds
+    int64_t             sq_buf_size;
+
+    // make decoders skip non-reference frames when the output falls
+    // behind real time
+    int                 skip_on_overload;
+} SchProfile;
+
+static const SchProfile profiles[] = {
+    [SCH_PROFILE_BALANCED] = {
+        .queue_min          = { [QUEUE_PACKETS] = 1, [QUEUE_FRAMES] = 1 },
+        .queue_max          = { [QUEUE_PACKETS] = 1, [QUEUE_FRAMES] = 1 },
+        .schedule_tolerance = 100 * 1000,
+        .sq_buf_size        = 10 * 1000 * 1000,
+    },
+    [SCH_PROFILE_LATENCY] = {
+        .queue_min          = { [QUEUE_PACKETS] = 1, [QUEUE_FRAMES] = 1 },
+        .queue_max          = { [QUEUE_PACKETS] = 2, [QUEUE_FRAMES] = 2 },
+        .schedule_tolerance = 40 * 1000,
+        .sq_buf_size        = 1000 * 1000,
+        .skip_on_overload   = 1,
+    },
+    [SCH_PROFILE_THROUGHPUT] = {
+        .queue_min          = { [QUEUE_PACKETS] = 4,  [QUEUE_FRAMES] = 2 },
+        .queue_max          = { [QUEUE_PACKETS] = 64, [QUEUE_FRAMES] = 8 },
+        .schedule_tolerance = 500 * 1000,
+        .sq_buf_size        = 10 * 1000 * 1000,
+    },
+};
+
+// a queue whose capacity is adjusted by sch_wait()
+typedef struct SchQueueTune {
+    ThreadQueue        *queue;
+    enum QueueType      type;
+    ThreadQueueStats    prev;
+} SchQueueTune;
+
 typedef struct SchWaiter {
     pthread_mutex_t     lock;
     pthread_cond_t      cond;
     atomic_int          choked;
 
+    // total time in microseconds spent waiting while choked
+    atomic_int_least64_t choked_time;
+
     // the following are internal state of schedule_update_locked() and must not
     // be accessed outside of it
     int                 choked_prev;
@@ -292,6 +353,27 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    // JSON lines statistics, see sch_stats_file()
+    char               *stats_filename;
+    FILE               *stats_file;
+    int64_t             stats_start;
+    pthread_mutex_t     stats_lock;
+    AVBPrint            stats_frames;
+    uint64_t            stats_frames_dropped;
+
+    const SchProfile   *profile;
+
+    // queues with a variable capacity and the time of their last adjustment
+    SchQueueTune       *tune;
+    unsigned         nb_tune;
+    int64_t             tune_time;
+
+    // real time and trailing dts when the output started, used to detect
+    // output falling behind real time
+    int64_t             overload_start_time;
+    int64_t             overload_start_dts;
+    atomic_int          overloaded;
 };
 
 /**
@@ -302,11 +384,14 @@ struct Scheduler {
  */
 static int waiter_wait(Scheduler *sch, SchWaiter *w)
 {
+    int64_t wait_start;
     int terminate;
 
     if (!atomic_load(&w->choked))
         return 0;
 
+    wait_start = sch->stats_file ? av_gettime_relative() : 0;
+
     pthread_mutex_lock(&w->lock);
 
     while (atomic_load(&w->choked) && !atomic_load(&sch->terminate))
@@ -316,6 +401,9 @@ static int waiter_wait(Scheduler *sch, SchWaiter *w)
 
     pthread_mutex_unlock(&w->lock);
 
+    if (sch->stats_file)
+        atomic_fetch_add(&w->choked_time, av_gettime_relative() - wait_start);
+
     return terminate;
 }
 
@@ -334,6 +422,7 @@ static int waiter_init(SchWaiter *w)
     int ret;
 
     atomic_init(&w->choked, 0);
+    atomic_init(&w->choked_time, 0);
 
     ret = pthread_mutex_init(&w->lock, NULL);
     if (ret)
@@ -352,25 +441,48 @@ static void waiter_uninit(SchWaiter *w)
     pthread_cond_destroy(&w->cond);
 }
 
-static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
-                       enum QueueType type)
+/**
+ * Allocate a queue with room for the given number of items, or for the
+ * profile's minimum with queue_size 0. The capacity is adjusted at runtime
+ * when the profile allows for more.
+ */
+static int queue_alloc(Scheduler *sch, ThreadQueue **ptq, unsigned nb_streams,
+                       unsigned queue_size, enum QueueType type, int flags)
 {
     ThreadQueue *tq;
     ObjPool *op;
 
+    if (!queue_size)
+        queue_size = sch->profile->queue_min[type];
+    queue_size = FFMIN(queue_size, sch->profile->queue_max[type]);
+
     op = (type == QUEUE_PACKETS) ? objpool_alloc_packets() :
                                    objpool_alloc_frames();
     if (!op)
         return AVERROR(ENOMEM);
 
-    tq = tq_alloc(nb_streams, queue_size, op,
-                  (type == QUEUE_PACKETS) ? pkt_move : frame_move);
+    if (sch->stats_filename || queue_size < sch->profile->queue_max[type])
+        flags |= TQ_STATS;
+
+    tq = tq_alloc(nb_streams, sch->profile->queue_max[type], op,
+                  (type == QUEUE_PACKETS) ? pkt_move : frame_move, flags);
     if (!tq) {
         objpool_free(&op);
         return AVERROR(ENOMEM);
     }
-
     *ptq = tq;
+
+    tq_set_capacity(tq, queue_size);
+
+    if (queue_size < sch->profile->queue_max[type]) {
+        int ret = GROW_ARRAY(sch->tune, sch->nb_tune);
+        if (ret < 0)
+            return ret;
+
+        sch->tune[sch->nb_tune - 1].queue = tq;
+        sch->tune[sch->nb_tune - 1].type  = type;
+    }
+
     return 0;
 }
 
@@ -445,6 +557,73 @@ static int64_t trailing_dts(const Scheduler *sch, int count_finished)
     return min_dts == INT64_MAX ? AV_NOPTS_VALUE : min_dts;
 }
 
+static void stats_write_queue(AVBPrint *bp, const char *type, unsigned idx,
+                              ThreadQueue *tq, int *nb_written)
+{
+    ThreadQueueStats st;
+
+    if (!tq)
+        return;
+
+    tq_stats(tq, &st);
+
+    av_bprintf(bp, "%s{\"to\":\"%s\",\"index\":%u,\"sent\":%"PRIu64","
+               "\"received\":%"PRIu64",\"send_wait_us\":%"PRId64","
+               "\"receive_wait_us\":%"PRId64",\"depth\":[",
+               (*nb_written)++ ? "," : "", type, idx,
+               st.nb_sent, st.nb_received, st.send_wait, st.receive_wait);
+    for (int i = 0; i < TQ_DEPTH_BUCKETS; i++)
+        av_bprintf(bp, "%s%"PRIu64, i ? "," : "", st.depth[i]);
+    av_bprintf(bp, "]}");
+}
+
+/**
+ * Write a snapshot of the queue and node statistics, followed by the pending
+ * per-frame records, to the statistics file.
+ */
+static void stats_write(Scheduler *sch)
+{
+    AVBPrint bp;
+    int nb_queues = 0;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    av_bprintf(&bp, "{\"type\":\"sched\",\"time_us\":%"PRId64",\"nodes\":[",
+               av_gettime_relative() - sch->stats_start);
+    for (unsigned i = 0; i < sch->nb_demux; i++)
+        av_bprintf(&bp, "%s{\"type\":\"demux\",\"index\":%u,\"choked_us\":%"PRId64"}",
+                   i ? "," : "", i, atomic_load(&sch->demux[i].waiter.choked_time));
+    for (unsigned i = 0; i < sch->nb_filters; i++)
+        av_bprintf(&bp, "%s{\"type\":\"filter\",\"index\":%u,\"choked_us\":%"PRId64"}",
+                   (i || sch->nb_demux) ? "," : "", i,
+                   atomic_load(&sch->filters[i].waiter.choked_time));
+
+    av_bprintf(&bp, "],\"queues\":[");
+    for (unsigned i = 0; i < sch->nb_dec; i++)
+        stats_write_queue(&bp, "dec", i, sch->dec[i].queue, &nb_queues);
+    for (unsigned i = 0; i < sch->nb_filters; i++)
+        stats_write_queue(&bp, "filter", i, sch->filters[i].queue, &nb_queues);
+    for (unsigned i = 0; i < sch->nb_enc; i++)
+        stats_write_queue(&bp, "enc", i, sch->enc[i].queue, &nb_queues);
+    for (unsigned i = 0; i < sch->nb_mux; i++)
+        stats_write_queue(&bp, "mux", i, sch->mux[i].queue, &nb_queues);
+
+    pthread_mutex_lock(&sch->stats_lock);
+
+    av_bprintf(&bp, "],\"frames_dropped\":%"PRIu64"}\n", sch->stats_frames_dropped);
+    if (av_bprint_is_complete(&bp) && av_bprint_is_complete(&sch->stats_frames)) {
+        fwrite(bp.str, 1, bp.len, sch->stats_file);
+        fwrite(sch->stats_frames.str, 1, sch->stats_frames.len, sch->stats_file);
+    }
+    av_bprint_clear(&sch->stats_frames);
+
+    pthread_mutex_unlock(&sch->stats_lock);
+
+    av_bprint_finalize(&bp, NULL);
+
+    fflush(sch->stats_file);
+}
+
 int sch_stop(Scheduler *sch, int64_t *finish_ts)
 {
     int ret = 0, err;
@@ -495,6 +674,13 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
     if (finish_ts)
         *finish_ts = trailing_dts(sch, 1);
 
+    if (sch->stats_file) {
+        stats_write(sch);
+        if (fclose(sch->stats_file))
+            av_log(sch, AV_LOG_ERROR, "Error closing the statistics file\n");
+        sch->stats_file = NULL;
+    }
+
     return ret;
 }
 
@@ -590,6 +776,8 @@ void sch_free(Scheduler **psch)
 
     av_freep(&sch->sdp_filename);
 
+    av_freep(&sch->tune);
+
     pthread_mutex_destroy(&sch->schedule_lock);
 
     pthread_mutex_destroy(&sch->mux_ready_lock);
@@ -597,6 +785,10 @@ void sch_free(Scheduler **psch)
     pthread_mutex_destroy(&sch->mux_done_lock);
     pthread_cond_destroy(&sch->mux_done_cond);
 
+    av_freep(&sch->stats_filename);
+    pthread_mutex_destroy(&sch->stats_lock);
+    av_bprint_finalize(&sch->stats_frames, NULL);
+
     av_freep(psch);
 }
 
@@ -633,6 +825,15 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->stats_lock, NULL);
+    if (ret)
+        goto fail;
+
+    av_bprint_init(&sch->stats_frames, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    sch->profile = &profiles[SCH_PROFILE_BALANCED];
+    atomic_init(&sch->overloaded, 0);
+
     return sch;
 fail:
     sch_free(&sch);
@@ -646,6 +847,82 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+int sch_stats_file(Scheduler *sch, const char *filename)
+{
+    av_assert0(!sch->transcode_started);
+
+    av_freep(&sch->stats_filename);
+    sch->stats_filename = av_strdup(filename);
+    return sch->stats_filename ? 0 : AVERROR(ENOMEM);
+}
+
+void sch_stats_frame(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
+                     int64_t pts, AVRational tb, const char * const *stage_names,
+                     const int64_t *stage_times, unsigned nb_stages)
+{
+    int64_t start = INT64_MIN;
+    int first = 1;
+
+    if (!sch->stats_file)
+        return;
+
+    pthread_mutex_lock(&sch->stats_lock);
+
+    if (sch->stats_frames.len >= STATS_FRAMES_MAX_SIZE) {
+        sch->stats_frames_dropped++;
+        goto finish;
+    }
+
+    av_bprintf(&sch->stats_frames, "{\"type\":\"frame\",\"mux\":%u,\"stream\":%u,",
+               mux_idx, stream_idx);
+    if (pts == AV_NOPTS_VALUE)
+        av_bprintf(&sch->stats_frames, "\"pts\":null,\"pts_time\":null,");
+    else
+        av_bprintf(&sch->stats_frames, "\"pts\":%"PRId64",\"pts_time\":%g,",
+                   pts, pts * av_q2d(tb));
+    av_bprintf(&sch->stats_frames, "\"stages_us\":{");
+
+    // stage times are relative to the first stage the frame went through
+    for (unsigned i = 0; i < nb_stages; i++) {
+        if (stage_times[i] == INT64_MIN)
+            continue;
+        if (start == INT64_MIN)
+            start = stage_times[i];
+
+        av_bprintf(&sch->stats_frames, "%s\"%s\":%"PRId64, first ? "" : ",",
+                   stage_names[i], stage_times[i] - start);
+        first = 0;
+    }
+
+    av_bprintf(&sch->stats_frames, "%s\"mux\":%"PRId64"}}\n", first ? "" : ",",
+               start == INT64_MIN ? 0 : av_gettime_relative() - start);
+
+finish:
+    pthread_mutex_unlock(&sch->stats_lock);
+}
+
+int sch_profile(Scheduler *sch, enum SchedulerProfile profile)
+{
+    av_assert0(!sch->transcode_started);
+
+    if (profile < 0 || profile >= FF_ARRAY_ELEMS(profiles))
+        return AVERROR(EINVAL);
+
+    sch->profile = &profiles[profile];
+
+    return 0;
+}
+
+int64_t sch_sq_buf_size(const Scheduler *sch)
+{
+    return sch->profile->sq_buf_size;
+}
+
+int sch_overloaded(Scheduler *sch)
+{
+    return atomic_load_explicit(&sch->overloaded, memory_order_relaxed);
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -773,10 +1050,6 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!dec->send_frame)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&dec->queue, 1, 1, QUEUE_PACKETS);
-    if (ret < 0)
-        return ret;
-
     if (send_end_ts) {
         ret = av_thread_message_queue_alloc(&dec->queue_end_ts, 1, sizeof(Timestamp));
         if (ret < 0)
@@ -813,10 +1086,6 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
 
     task_init(sch, &enc->task, SCH_NODE_TYPE_ENC, idx, func, ctx);
 
-    ret = queue_alloc(&enc->queue, 1, 1, QUEUE_FRAMES);
-    if (ret < 0)
-        return ret;
-
     return idx;
 }
 
@@ -861,10 +1130,6 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 1, QUEUE_FRAMES);
-    if (ret < 0)
-        return ret;
-
     return idx;
 }
 
@@ -1229,7 +1494,7 @@ static void schedule_update_locked(Scheduler *sch)
                 continue;
             if (dts == AV_NOPTS_VALUE && ms->last_dts != AV_NOPTS_VALUE)
                 continue;
-            if (dts != AV_NOPTS_VALUE && ms->last_dts - dts >= SCHEDULE_TOLERANCE)
+            if (dts != AV_NOPTS_VALUE && ms->last_dts - dts >= sch->profile->schedule_tolerance)
                 continue;
 
             // for outputs fed from filtergraphs, consider that filtergraph's
@@ -1279,12 +1544,81 @@ static void schedule_update_locked(Scheduler *sch)
 
 }
 
+/**
+ * Allocate the decoder and encoder queues, which have a single producer
+ * and consumer unless noted otherwise.
+ */
+static int start_queues_alloc(Scheduler *sch)
+{
+    int ret;
+
+    for (unsigned i = 0; i < sch->nb_dec; i++) {
+        SchDec *dec = &sch->dec[i];
+        int flags = TQ_SINGLE_PRODUCER_CONSUMER;
+
+        // subtitle heartbeats are sent from muxer threads, in addition to
+        // the packets from the demuxer thread
+        for (unsigned j = 0; j < sch->nb_mux; j++) {
+            SchMux *mux = &sch->mux[j];
+
+            for (unsigned k = 0; k < mux->nb_streams; k++) {
+                SchMuxStream *ms = &mux->streams[k];
+
+                for (unsigned l = 0; l < ms->nb_sub_heartbeat_dst; l++)
+                    if (ms->sub_heartbeat_dst[l] == i)
+                        flags = 0;
+            }
+        }
+
+        ret = queue_alloc(sch, &dec->queue, 1, 0, QUEUE_PACKETS, flags);
+        if (ret < 0)
+            return ret;
+    }
+
+    // an encoder is fed either by its source thread alone or through a sync
+    // queue, in which case all senders hold the sync queue lock
+    for (unsigned i = 0; i < sch->nb_enc; i++) {
+        ret = queue_alloc(sch, &sch->enc[i].queue, 1, 0, QUEUE_FRAMES,
+                          TQ_SINGLE_PRODUCER_CONSUMER);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (unsigned i = 0; i < sch->nb_filters; i++) {
+        SchFilterGraph *fg = &sch->filters[i];
+
+        ret = queue_alloc(sch, &fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 int sch_start(Scheduler *sch)
 {
     int ret;
 
     sch->transcode_started = 1;
 
+    if (sch->stats_filename) {
+        sch->stats_file = fopen(sch->stats_filename, "w");
+        if (!sch->stats_file) {
+            ret = AVERROR(errno);
+            av_log(sch, AV_LOG_ERROR, "Error opening the statistics file '%s': %s\n",
+                   sch->stats_filename, av_err2str(ret));
+            return ret;
+        }
+        sch->stats_start = av_gettime_relative();
+    }
+
+    ret = start_queues_alloc(sch);
+    if (ret < 0)
+        return ret;
+
+    sch->tune_time          = av_gettime_relative();
+    sch->overload_start_dts = AV_NOPTS_VALUE;
+
     for (unsigned i = 0; i < sch->nb_mux; i++) {
         SchMux *mux = &sch->mux[i];
 
@@ -1313,7 +1647,7 @@ int sch_start(Scheduler *sch)
             }
         }
 
-        ret = queue_alloc(&mux->queue, mux->nb_streams, 1, QUEUE_PACKETS);
+        ret = queue_alloc(sch, &mux->queue, mux->nb_streams, 0, QUEUE_PACKETS, 0);
         if (ret < 0)
             return ret;
 
@@ -1428,10 +1762,95 @@ int sch_start(Scheduler *sch)
     return 0;
 }
 
+/**
+ * Adjust the capacity of a queue to the stalls observed since the last call.
+ */
+static void queue_tune(Scheduler *sch, SchQueueTune *qt, int64_t interval)
+{
+    const unsigned min = sch->profile->queue_min[qt->type];
+    const unsigned max = sch->profile->queue_max[qt->type];
+    size_t capacity = tq_capacity(qt->queue);
+    ThreadQueueStats st;
+    int64_t send_wait, receive_wait;
+    uint64_t nb_deep = 0;
+
+    tq_stats(qt->queue, &st);
+
+    send_wait    = st.send_wait    - qt->prev.send_wait;
+    receive_wait = st.receive_wait - qt->prev.receive_wait;
+
+    // sends that found the queue at least half full
+    for (int i = FFMIN(av_log2(capacity), TQ_DEPTH_BUCKETS - 1); i < TQ_DEPTH_BUCKETS; i++)
+        nb_deep += st.depth[i] - qt->prev.depth[i];
+
+    // both sides waiting for each other means the load is bursty, which a
+    // deeper queue can absorb; when only one side waits, it is simply faster
+    // than the other one and more buffering would not help
+    if (capacity < max &&
+        send_wait    * QUEUE_STALL_DIV > interval &&
+        receive_wait * QUEUE_STALL_DIV > interval)
+        capacity *= 2;
+    else if (capacity > min && !send_wait && !nb_deep &&
+             st.nb_sent > qt->prev.nb_sent)
+        capacity /= 2;
+
+    if (capacity != tq_capacity(qt->queue)) {
+        av_log(sch, AV_LOG_DEBUG, "Queue %td capacity %zu -> %zu\n",
+               qt - sch->tune, tq_capacity(qt->queue), capacity);
+        tq_set_capacity(qt->queue, capacity);
+    }
+
+    qt->prev = st;
+}
+
+/**
+ * Detect whether the output runs slower than real time.
+ */
+static void overload_update(Scheduler *sch, int64_t now)
+{
+    int64_t dts = atomic_load(&sch->last_dts);
+    int overloaded = atomic_load(&sch->overloaded);
+    int64_t lag;
+
+    if (dts == AV_NOPTS_VALUE)
+        return;
+
+    if (sch->overload_start_dts == AV_NOPTS_VALUE) {
+        sch->overload_start_dts  = dts;
+        sch->overload_start_time = now;
+        return;
+    }
+
+    lag = (now - sch->overload_start_time) - (dts - sch->overload_start_dts);
+
+    if (!overloaded && lag > OVERLOAD_LAG) {
+        av_log(sch, AV_LOG_WARNING, "Output is %.3fs behind real time, "
+               "skipping non-reference frames\n", lag / 1e6);
+        atomic_store(&sch->overloaded, 1);
+    } else if (overloaded && lag < OVERLOAD_LAG / 2) {
+        av_log(sch, AV_LOG_VERBOSE, "Output caught up with real time\n");
+        atomic_store(&sch->overloaded, 0);
+    }
+}
+
 int sch_wait(Scheduler *sch, uint64_t timeout_us, int64_t *transcode_ts)
 {
     int ret, err;
 
+    if (sch->stats_file)
+        stats_write(sch);
+
+    if (sch->nb_tune || sch->profile->skip_on_overload) {
+        int64_t now = av_gettime_relative();
+
+        for (unsigned i = 0; i < sch->nb_tune; i++)
+            queue_tune(sch, &sch->tune[i], now - sch->tune_time);
+        sch->tune_time = now;
+
+        if (sch->profile->skip_on_overload)
+            overload_update(sch, now);
+    }
+
     // convert delay to absolute timestamp
     timeout_us += av_gettime();
 
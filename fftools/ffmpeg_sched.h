@@ -270,6 +270,68 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Periodically write scheduler statistics to the given file as JSON lines,
+ * from sch_wait() and once more when transcoding stops:
+ * - a "sched" object with the time each demuxer and filtergraph spent choked
+ *   and, for every decoder, filtergraph, encoder and muxer input queue, the
+ *   number of items passed, the time spent waiting on either side and a
+ *   histogram of the queue depth, see ThreadQueueStats;
+ * - a "frame" object for every packet reported with sch_stats_frame() since
+ *   the previous dump.
+ *
+ * Must be called before sch_start().
+ */
+int sch_stats_file(Scheduler *sch, const char *filename);
+
+/**
+ * Report the wallclock times at which a packet about to be muxed and the frame
+ * it was encoded from passed through the stages of the pipeline. Stages with
+ * a time of INT64_MIN are skipped, the time of the call is recorded as the
+ * final "mux" stage. Does nothing unless sch_stats_file() was called.
+ */
+void sch_stats_frame(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
+                     int64_t pts, AVRational tb, const char * const *stage_names,
+                     const int64_t *stage_times, unsigned nb_stages);
+
+enum SchedulerProfile {
+    /**
+     * Single-item queues between all nodes, 100ms scheduling tolerance.
+     */
+    SCH_PROFILE_BALANCED,
+    /**
+     * Queues of one or two items, tight scheduling tolerance and short sync
+     * queue buffering. When the output falls behind real time, decoders skip
+     * non-reference frames until it has caught up, see sch_overloaded().
+     */
+    SCH_PROFILE_LATENCY,
+    /**
+     * Deeper queues that grow when the nodes on both sides stall on them,
+     * loose scheduling tolerance.
+     */
+    SCH_PROFILE_THROUGHPUT,
+};
+
+/**
+ * Select the trade-off between latency and throughput made by the scheduler.
+ *
+ * Must be called before sch_start().
+ */
+int sch_profile(Scheduler *sch, enum SchedulerProfile profile);
+
+/**
+ * @return default maximum duration buffered in sync queues, in microseconds,
+ *         for the selected profile
+ */
+int64_t sch_sq_buf_size(const Scheduler *sch);
+
+/**
+ * @return nonzero when the output has fallen behind real time with a profile
+ *         that prefers skipping work over adding latency; may be called from
+ *         any thread
+ */
+int sch_overloaded(Scheduler *sch);
+
 /**
  * Add an encoder to the scheduler.
  *
@@ -38,6 +38,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/classification_scores.h"
 #include "libavutil/display.h"
 #include "libavutil/hash.h"
 #include "libavutil/hdr_dynamic_metadata.h"
@@ -2327,6 +2328,25 @@ static void print_ambient_viewing_environment(WriterContext *w,
     print_q("ambient_light_y",     env->ambient_light_y,     '/');
 }
 
+static void print_classification_scores(WriterContext *w,
+                                        const AVClassificationScores *scores)
+{
+    const float *data;
+    AVBPrint pbuf;
+
+    if (!scores)
+        return;
+
+    data = av_classification_scores_get(scores);
+    av_bprint_init(&pbuf, 1, AV_BPRINT_SIZE_UNLIMITED);
+
+    print_str("model_id",  scores->model_id);
+    print_int("top_class", scores->top_class);
+    print_list_fmt("scores", "%.5f", scores->nb_scores, 1, data[idx]);
+
+    av_bprint_finalize(&pbuf, NULL);
+}
+
 static void print_pkt_side_data(WriterContext *w,
                                 AVCodecParameters *par,
                                 const AVPacketSideData *sd,
@@ -2697,6 +2717,8 @@ static void print_frame_side_data(WriterContext *w,
             print_dynamic_hdr_vivid(w, metadata);
         } else if (sd->type == AV_FRAME_DATA_AMBIENT_VIEWING_ENVIRONMENT) {
             print_ambient_viewing_environment(w, (const AVAmbientViewingEnvironment *)sd->data);
+        } else if (sd->type == AV_FRAME_DATA_CLASSIFICATION_SCORES) {
+            print_classification_scores(w, (const AVClassificationScores *)sd->data);
         }
         writer_print_section_footer(w);
     }
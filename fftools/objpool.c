@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 
 #include "libavcodec/packet.h"
@@ -24,6 +25,7 @@
 #include "libavutil/error.h"
 #include "libavutil/frame.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 
 #include "objpool.h"
 
@@ -129,3 +131,209 @@ ObjPool *objpool_alloc_frames(void)
 {
     return objpool_alloc(alloc_frame, reset_frame, free_frame);
 }
+
+/* buffers between 4 KiB and 256 MiB are pooled, larger ones are not;
+ * each octave is split into 8 size classes, so at most 12.5% is wasted */
+#define BUFPOOL_MIN_SHIFT 12
+#define BUFPOOL_MAX_SHIFT 28
+#define BUFPOOL_CLASS_BITS 3
+#define BUFPOOL_NB_CLASSES (((BUFPOOL_MAX_SHIFT - BUFPOOL_MIN_SHIFT) << BUFPOOL_CLASS_BITS) + 1)
+
+typedef struct BufPoolEntry {
+    BufPool             *pool;
+    struct BufPoolEntry *next;
+    uint8_t             *data;
+    unsigned int         size_class;
+} BufPoolEntry;
+
+typedef struct BufPoolClass {
+    pthread_mutex_t lock;
+    BufPoolEntry   *free_list;
+} BufPoolClass;
+
+struct BufPool {
+    BufPoolClass classes[BUFPOOL_NB_CLASSES];
+    size_t       max_cached;
+
+    /* one reference for the owner and one for each buffer handed out */
+    atomic_uint  refcount;
+
+    atomic_uint_least64_t nb_hits;
+    atomic_uint_least64_t nb_misses;
+    atomic_size_t         bytes_in_use;
+    atomic_size_t         bytes_cached;
+    atomic_size_t         peak_bytes;
+};
+
+static size_t class_size(unsigned int size_class)
+{
+    unsigned int shift = (size_class >> BUFPOOL_CLASS_BITS) + BUFPOOL_MIN_SHIFT - BUFPOOL_CLASS_BITS;
+    size_t       steps = (size_class & ((1 << BUFPOOL_CLASS_BITS) - 1)) + (1 << BUFPOOL_CLASS_BITS);
+
+    return steps << shift;
+}
+
+/* smallest class holding size bytes, BUFPOOL_NB_CLASSES if there is none */
+static unsigned int size_to_class(size_t size)
+{
+    unsigned int shift;
+
+    if (size <= class_size(0))
+        return 0;
+    if (size > class_size(BUFPOOL_NB_CLASSES - 1))
+        return BUFPOOL_NB_CLASSES;
+
+    /* size - 1 is at least 1 << BUFPOOL_MIN_SHIFT, round it up to the next
+     * multiple of the class step of its octave */
+    size--;
+    shift = av_log2(size);
+    return ((shift - BUFPOOL_MIN_SHIFT) << BUFPOOL_CLASS_BITS) +
+           (size >> (shift - BUFPOOL_CLASS_BITS)) - ((1 << BUFPOOL_CLASS_BITS) - 1);
+}
+
+static void bufpool_unref(BufPool *bp)
+{
+    if (atomic_fetch_sub_explicit(&bp->refcount, 1, memory_order_acq_rel) > 1)
+        return;
+
+    for (unsigned int i = 0; i < BUFPOOL_NB_CLASSES; i++) {
+        BufPoolEntry *e = bp->classes[i].free_list;
+
+        while (e) {
+            BufPoolEntry *next = e->next;
+            av_free(e->data);
+            av_free(e);
+            e = next;
+        }
+        pthread_mutex_destroy(&bp->classes[i].lock);
+    }
+
+    av_free(bp);
+}
+
+BufPool *bufpool_alloc(size_t max_cached)
+{
+    BufPool *bp = av_mallocz(sizeof(*bp));
+
+    if (!bp)
+        return NULL;
+
+    for (unsigned int i = 0; i < BUFPOOL_NB_CLASSES; i++) {
+        if (pthread_mutex_init(&bp->classes[i].lock, NULL)) {
+            while (i--)
+                pthread_mutex_destroy(&bp->classes[i].lock);
+            av_free(bp);
+            return NULL;
+        }
+    }
+
+    bp->max_cached = max_cached;
+    atomic_init(&bp->refcount, 1);
+
+    return bp;
+}
+
+void bufpool_free(BufPool **pbp)
+{
+    if (!*pbp)
+        return;
+
+    bufpool_unref(*pbp);
+    *pbp = NULL;
+}
+
+static void bufpool_release(void *opaque, uint8_t *data)
+{
+    BufPoolEntry *e  = opaque;
+    BufPool      *bp = e->pool;
+    BufPoolClass *c  = &bp->classes[e->size_class];
+    size_t      size = class_size(e->size_class);
+
+    atomic_fetch_sub(&bp->bytes_in_use, size);
+
+    if (atomic_fetch_add(&bp->bytes_cached, size) + size <= bp->max_cached) {
+        pthread_mutex_lock(&c->lock);
+        e->next      = c->free_list;
+        c->free_list = e;
+        pthread_mutex_unlock(&c->lock);
+    } else {
+        atomic_fetch_sub(&bp->bytes_cached, size);
+        av_free(e->data);
+        av_free(e);
+    }
+
+    bufpool_unref(bp);
+}
+
+static void update_peak(BufPool *bp)
+{
+    size_t total = atomic_load(&bp->bytes_in_use) + atomic_load(&bp->bytes_cached);
+    size_t peak  = atomic_load(&bp->peak_bytes);
+
+    while (total > peak &&
+           !atomic_compare_exchange_weak(&bp->peak_bytes, &peak, total))
+        ;
+}
+
+AVBufferRef *bufpool_get(BufPool *bp, size_t size)
+{
+    unsigned int size_class = size_to_class(size);
+    BufPoolClass *c;
+    BufPoolEntry *e;
+    AVBufferRef *buf;
+
+    if (size_class == BUFPOOL_NB_CLASSES) {
+        atomic_fetch_add(&bp->nb_misses, 1);
+        return av_buffer_alloc(size);
+    }
+    c = &bp->classes[size_class];
+
+    pthread_mutex_lock(&c->lock);
+    e = c->free_list;
+    if (e)
+        c->free_list = e->next;
+    pthread_mutex_unlock(&c->lock);
+
+    if (e) {
+        atomic_fetch_sub(&bp->bytes_cached, class_size(size_class));
+        atomic_fetch_add(&bp->nb_hits, 1);
+    } else {
+        e = av_mallocz(sizeof(*e));
+        if (!e)
+            return NULL;
+
+        /* zeroed once when the entry is created, like the buffers of the
+         * libavcodec default pool, so padding is never uninitialized */
+        e->data = av_mallocz(class_size(size_class));
+        if (!e->data) {
+            av_free(e);
+            return NULL;
+        }
+        e->pool       = bp;
+        e->size_class = size_class;
+
+        atomic_fetch_add(&bp->nb_misses, 1);
+    }
+
+    atomic_fetch_add(&bp->bytes_in_use, class_size(size_class));
+    atomic_fetch_add(&bp->refcount, 1);
+
+    buf = av_buffer_create(e->data, size, bufpool_release, e, 0);
+    if (!buf) {
+        bufpool_release(e, e->data);
+        return NULL;
+    }
+
+    update_peak(bp);
+
+    return buf;
+}
+
+void bufpool_stats(BufPool *bp, BufPoolStats *stats)
+{
+    stats->nb_hits      = atomic_load(&bp->nb_hits);
+    stats->nb_misses    = atomic_load(&bp->nb_misses);
+    stats->bytes_in_use = atomic_load(&bp->bytes_in_use);
+    stats->bytes_cached = atomic_load(&bp->bytes_cached);
+    stats->peak_bytes   = atomic_load(&bp->peak_bytes);
+}
@@ -19,6 +19,11 @@
 #ifndef FFTOOLS_OBJPOOL_H
 #define FFTOOLS_OBJPOOL_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/buffer.h"
+
 typedef struct ObjPool ObjPool;
 
 typedef void* (*ObjPoolCBAlloc)(void);
@@ -34,4 +39,39 @@ ObjPool *objpool_alloc_frames(void);
 int  objpool_get(ObjPool *op, void **obj);
 void objpool_release(ObjPool *op, void **obj);
 
+/**
+ * A thread-safe pool of data buffers shared between all the components that
+ * draw from it. Requests are rounded up to one of 8 size classes per power
+ * of two, so e.g. frames of different streams with similar dimensions share
+ * buffers. New buffers are zeroed, recycled ones keep their previous
+ * contents.
+ */
+typedef struct BufPool BufPool;
+
+typedef struct BufPoolStats {
+    uint64_t nb_hits;       ///< requests served from a cached buffer
+    uint64_t nb_misses;     ///< requests that had to allocate
+    size_t   bytes_in_use;  ///< size of the buffers currently handed out
+    size_t   bytes_cached;  ///< size of the idle buffers kept for reuse
+    size_t   peak_bytes;    ///< maximum of bytes_in_use + bytes_cached
+} BufPoolStats;
+
+/**
+ * @param max_cached maximum total size of the idle buffers kept in the pool
+ */
+BufPool *bufpool_alloc(size_t max_cached);
+
+/**
+ * Drop the caller's reference to the pool. The pool is destroyed once all
+ * the buffers obtained from it have been released.
+ */
+void     bufpool_free(BufPool **bp);
+
+/**
+ * @return a buffer of at least size bytes, NULL on allocation failure
+ */
+AVBufferRef *bufpool_get(BufPool *bp, size_t size);
+
+void     bufpool_stats(BufPool *bp, BufPoolStats *stats);
+
 #endif // FFTOOLS_OBJPOOL_H
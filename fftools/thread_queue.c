@@ -16,15 +16,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #include "objpool.h"
 #include "thread_queue.h"
@@ -39,12 +43,38 @@ typedef struct FifoElem {
     unsigned int stream_idx;
 } FifoElem;
 
+/* number of times a waiting thread polls the queue before it sleeps */
+#define SPIN_COUNT 1024
+
 struct ThreadQueue {
-    int              *finished;
+    atomic_int       *finished;
     unsigned int    nb_streams;
 
     AVFifo  *fifo;
 
+    /* number of items that may be queued before tq_send() blocks, at most
+     * the queue_size passed to tq_alloc() */
+    atomic_size_t     capacity;
+    size_t            queue_size;
+
+    /* lock-free ring used instead of the fifo with
+     * TQ_SINGLE_PRODUCER_CONSUMER; every slot owns an object, so the pool is
+     * only touched by the receiving thread while the queue is in use */
+    FifoElem         *ring;
+    size_t            ring_size;
+    atomic_size_t     ring_head; // next element to read, advanced by the consumer
+    atomic_size_t     ring_tail; // next element to write, advanced by the producer
+    atomic_uint       seq;       // incremented on every state change
+    atomic_int        nb_waiters;
+    int               spin_count;
+
+    int                   collect_stats;
+    atomic_uint_least64_t nb_sent;
+    atomic_uint_least64_t nb_received;
+    atomic_int_least64_t  send_wait;
+    atomic_int_least64_t  receive_wait;
+    atomic_uint_least64_t depth[TQ_DEPTH_BUCKETS];
+
     ObjPool *obj_pool;
     void   (*obj_move)(void *dst, void *src);
 
@@ -66,6 +96,12 @@ void tq_free(ThreadQueue **ptq)
     }
     av_fifo_freep2(&tq->fifo);
 
+    if (tq->ring) {
+        for (size_t i = 0; i < tq->ring_size; i++)
+            objpool_release(tq->obj_pool, &tq->ring[i].obj);
+    }
+    av_freep(&tq->ring);
+
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
@@ -77,7 +113,8 @@ void tq_free(ThreadQueue **ptq)
 }
 
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src))
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      int flags)
 {
     ThreadQueue *tq;
     int ret;
@@ -104,25 +141,235 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         goto fail;
     tq->nb_streams = nb_streams;
 
-    tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
-    if (!tq->fifo)
-        goto fail;
-
     tq->obj_pool = obj_pool;
     tq->obj_move = obj_move;
 
+    tq->collect_stats = !!(flags & TQ_STATS);
+
+    atomic_init(&tq->capacity, queue_size);
+    tq->queue_size = queue_size;
+
+    if (flags & TQ_SINGLE_PRODUCER_CONSUMER) {
+        tq->ring = av_calloc(queue_size, sizeof(*tq->ring));
+        if (!tq->ring)
+            goto fail;
+        tq->ring_size = queue_size;
+
+        for (size_t i = 0; i < queue_size; i++) {
+            ret = objpool_get(obj_pool, &tq->ring[i].obj);
+            if (ret < 0)
+                goto fail;
+        }
+
+        atomic_init(&tq->ring_head,  0);
+        atomic_init(&tq->ring_tail,  0);
+        atomic_init(&tq->seq,        0);
+        atomic_init(&tq->nb_waiters, 0);
+
+        /* spinning only helps when the other side runs concurrently */
+        tq->spin_count = av_cpu_count() > 1 ? SPIN_COUNT : 0;
+    } else {
+        tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
+        if (!tq->fifo)
+            goto fail;
+    }
+
     return tq;
 fail:
     tq_free(&tq);
     return NULL;
 }
 
+static int64_t stats_wait_start(const ThreadQueue *tq)
+{
+    return tq->collect_stats ? av_gettime_relative() : 0;
+}
+
+static void stats_wait_end(const ThreadQueue *tq, atomic_int_least64_t *total,
+                           int64_t start)
+{
+    if (tq->collect_stats)
+        atomic_fetch_add_explicit(total, av_gettime_relative() - start,
+                                  memory_order_relaxed);
+}
+
+static void stats_sent(ThreadQueue *tq, size_t depth)
+{
+    int bucket = depth ? FFMIN(av_log2(depth) + 1, TQ_DEPTH_BUCKETS - 1) : 0;
+
+    if (!tq->collect_stats)
+        return;
+
+    atomic_fetch_add_explicit(&tq->nb_sent, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tq->depth[bucket], 1, memory_order_relaxed);
+}
+
+static void stats_received(ThreadQueue *tq)
+{
+    if (tq->collect_stats)
+        atomic_fetch_add_explicit(&tq->nb_received, 1, memory_order_relaxed);
+}
+
+void tq_stats(ThreadQueue *tq, ThreadQueueStats *stats)
+{
+    stats->nb_sent      = atomic_load_explicit(&tq->nb_sent,      memory_order_relaxed);
+    stats->nb_received  = atomic_load_explicit(&tq->nb_received,  memory_order_relaxed);
+    stats->send_wait    = atomic_load_explicit(&tq->send_wait,    memory_order_relaxed);
+    stats->receive_wait = atomic_load_explicit(&tq->receive_wait, memory_order_relaxed);
+    for (int i = 0; i < TQ_DEPTH_BUCKETS; i++)
+        stats->depth[i] = atomic_load_explicit(&tq->depth[i], memory_order_relaxed);
+}
+
+/* signal a state change of a lock-free queue to the other side */
+static void ring_notify(ThreadQueue *tq)
+{
+    atomic_fetch_add(&tq->seq, 1);
+
+    /* pairs with the increment of nb_waiters in ring_wait(): either the
+     * waiter sees the new seq or we see the waiter */
+    if (atomic_load(&tq->nb_waiters)) {
+        pthread_mutex_lock(&tq->lock);
+        pthread_cond_broadcast(&tq->cond);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
+
+/* wait until the state of a lock-free queue changed since seq was read */
+static void ring_wait(ThreadQueue *tq, unsigned int seq)
+{
+    for (int i = 0; i < tq->spin_count; i++) {
+        if (atomic_load_explicit(&tq->seq, memory_order_acquire) != seq)
+            return;
+    }
+
+    atomic_fetch_add(&tq->nb_waiters, 1);
+
+    pthread_mutex_lock(&tq->lock);
+    while (atomic_load(&tq->seq) == seq)
+        pthread_cond_wait(&tq->cond, &tq->lock);
+    pthread_mutex_unlock(&tq->lock);
+
+    atomic_fetch_sub(&tq->nb_waiters, 1);
+}
+
+static int ring_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+    size_t tail = atomic_load_explicit(&tq->ring_tail, memory_order_relaxed);
+    int64_t wait_start;
+    FifoElem *elem;
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    stats_sent(tq, tail - atomic_load_explicit(&tq->ring_head, memory_order_relaxed));
+
+    while (1) {
+        unsigned int seq = atomic_load(&tq->seq);
+
+        if (atomic_load(finished) & FINISHED_RECV) {
+            atomic_fetch_or(finished, FINISHED_SEND);
+            return AVERROR_EOF;
+        }
+        if (tail - atomic_load_explicit(&tq->ring_head, memory_order_acquire) <
+            atomic_load_explicit(&tq->capacity, memory_order_relaxed))
+            break;
+
+        wait_start = stats_wait_start(tq);
+        ring_wait(tq, seq);
+        stats_wait_end(tq, &tq->send_wait, wait_start);
+    }
+
+    elem = &tq->ring[tail % tq->ring_size];
+    elem->stream_idx = stream_idx;
+    tq->obj_move(elem->obj, data);
+
+    atomic_store_explicit(&tq->ring_tail, tail + 1, memory_order_release);
+    ring_notify(tq);
+
+    return 0;
+}
+
+static int ring_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    size_t head = atomic_load_explicit(&tq->ring_head, memory_order_relaxed);
+    int64_t wait_start;
+
+    while (1) {
+        unsigned int seq = atomic_load(&tq->seq);
+        unsigned int nb_finished = 0;
+        int finished;
+
+        if (head != atomic_load_explicit(&tq->ring_tail, memory_order_acquire)) {
+            FifoElem *elem = &tq->ring[head % tq->ring_size];
+            int discard = atomic_load(&tq->finished[elem->stream_idx]) & FINISHED_RECV;
+
+            if (discard) {
+                /* the pool resets the object and hands it straight back */
+                objpool_release(tq->obj_pool, &elem->obj);
+                if (objpool_get(tq->obj_pool, &elem->obj) < 0)
+                    return AVERROR(ENOMEM);
+            } else {
+                tq->obj_move(data, elem->obj);
+                *stream_idx = elem->stream_idx;
+                stats_received(tq);
+            }
+
+            atomic_store_explicit(&tq->ring_head, ++head, memory_order_release);
+            ring_notify(tq);
+
+            if (discard)
+                continue;
+            return 0;
+        }
+
+        for (unsigned int i = 0; i < tq->nb_streams; i++) {
+            finished = atomic_load(&tq->finished[i]);
+            if (!finished)
+                continue;
+
+            /* the producer sets FINISHED_SEND after its last element, make
+             * sure that element is not overtaken by the EOF */
+            if (head != atomic_load(&tq->ring_tail))
+                break;
+
+            /* return EOF to the consumer at most once for each stream */
+            if (!(finished & FINISHED_RECV)) {
+                atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+                *stream_idx = i;
+                return AVERROR_EOF;
+            }
+
+            nb_finished++;
+        }
+
+        if (nb_finished == tq->nb_streams)
+            return AVERROR_EOF;
+        if (head != atomic_load(&tq->ring_tail))
+            continue;
+
+        wait_start = stats_wait_start(tq);
+        ring_wait(tq, seq);
+        stats_wait_end(tq, &tq->receive_wait, wait_start);
+    }
+}
+
+static int fifo_full(ThreadQueue *tq)
+{
+    return av_fifo_can_read(tq->fifo) >=
+           atomic_load_explicit(&tq->capacity, memory_order_relaxed);
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
-    int *finished;
+    atomic_int *finished;
     int ret;
 
     av_assert0(stream_idx < tq->nb_streams);
+
+    if (tq->ring)
+        return ring_send(tq, stream_idx, data);
+
     finished = &tq->finished[stream_idx];
 
     pthread_mutex_lock(&tq->lock);
@@ -132,8 +379,16 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
         goto finish;
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo))
-        pthread_cond_wait(&tq->cond, &tq->lock);
+    stats_sent(tq, av_fifo_can_read(tq->fifo));
+
+    if (!(*finished & FINISHED_RECV) && fifo_full(tq)) {
+        int64_t wait_start = stats_wait_start(tq);
+
+        while (!(*finished & FINISHED_RECV) && fifo_full(tq))
+            pthread_cond_wait(&tq->cond, &tq->lock);
+
+        stats_wait_end(tq, &tq->send_wait, wait_start);
+    }
 
     if (*finished & FINISHED_RECV) {
         ret = AVERROR_EOF;
@@ -173,6 +428,7 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
         tq->obj_move(data, elem.obj);
         objpool_release(tq->obj_pool, &elem.obj);
         *stream_idx = elem.stream_idx;
+        stats_received(tq);
         return 0;
     }
 
@@ -199,6 +455,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     *stream_idx = -1;
 
+    if (tq->ring)
+        return ring_receive(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -211,7 +470,11 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
             pthread_cond_broadcast(&tq->cond);
 
         if (ret == AVERROR(EAGAIN)) {
+            int64_t wait_start = stats_wait_start(tq);
+
             pthread_cond_wait(&tq->cond, &tq->lock);
+
+            stats_wait_end(tq, &tq->receive_wait, wait_start);
             continue;
         }
 
@@ -223,10 +486,40 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
     return ret;
 }
 
+size_t tq_capacity(ThreadQueue *tq)
+{
+    return atomic_load(&tq->capacity);
+}
+
+void tq_set_capacity(ThreadQueue *tq, size_t capacity)
+{
+    capacity = av_clip64(capacity, 1, tq->queue_size);
+
+    if (tq->ring) {
+        atomic_store(&tq->capacity, capacity);
+        ring_notify(tq);
+        return;
+    }
+
+    pthread_mutex_lock(&tq->lock);
+
+    atomic_store(&tq->capacity, capacity);
+    /* a sender may now fit into the queue */
+    pthread_cond_broadcast(&tq->cond);
+
+    pthread_mutex_unlock(&tq->lock);
+}
+
 void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
+        ring_notify(tq);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as send-finished;
@@ -242,6 +535,12 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
+        ring_notify(tq);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as recv-finished;
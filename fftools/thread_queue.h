@@ -25,21 +25,73 @@
 
 typedef struct ThreadQueue ThreadQueue;
 
+enum ThreadQueueFlags {
+    /**
+     * At most one thread sends to the queue and at most one receives from it
+     * at any given time, e.g. because all senders are serialized by a lock.
+     * The queue then works without locks, a waiting thread spins for a while
+     * before it goes to sleep.
+     */
+    TQ_SINGLE_PRODUCER_CONSUMER = (1 << 0),
+    /**
+     * Collect the statistics returned by tq_stats().
+     */
+    TQ_STATS                    = (1 << 1),
+};
+
+#define TQ_DEPTH_BUCKETS 6
+
+typedef struct ThreadQueueStats {
+    uint64_t nb_sent;       ///< number of tq_send() calls
+    uint64_t nb_received;   ///< number of items returned by tq_receive()
+    /**
+     * Total time in microseconds tq_send()/tq_receive() spent waiting for the
+     * other side.
+     */
+    int64_t  send_wait;
+    int64_t  receive_wait;
+    /**
+     * Number of items already queued when tq_send() was called, before any
+     * waiting: bucket 0 counts an empty queue, bucket i > 0 counts depths in
+     * [2^(i-1), 2^i), the last bucket also counts all deeper queues.
+     */
+    uint64_t depth[TQ_DEPTH_BUCKETS];
+} ThreadQueueStats;
+
 /**
  * Allocate a queue for sending data between threads.
  *
  * @param nb_streams number of streams for which a distinct EOF state is
  *                   maintained
  * @param queue_size number of items that can be stored in the queue without
- *                   blocking
+ *                   blocking; also the largest capacity that can be set with
+ *                   tq_set_capacity()
  * @param obj_pool object pool that will be used to allocate items stored in the
  *                 queue; the pool becomes owned by the queue
  * @param callback that moves the contents between two data pointers
+ * @param flags a combination of ThreadQueueFlags
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src));
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      int flags);
 void         tq_free(ThreadQueue **tq);
 
+/**
+ * Get a snapshot of the statistics of a queue allocated with TQ_STATS. May be
+ * called from any thread.
+ */
+void tq_stats(ThreadQueue *tq, ThreadQueueStats *stats);
+
+/**
+ * Change the number of items that can be stored in the queue without
+ * blocking. The new value is clipped to the range between 1 and the
+ * queue_size passed to tq_alloc(). Items already queued beyond the new
+ * capacity are not discarded, senders block until the queue drained below it.
+ * May be called from any thread.
+ */
+void   tq_set_capacity(ThreadQueue *tq, size_t capacity);
+size_t tq_capacity(ThreadQueue *tq);
+
 /**
  * Send an item for the given stream to the queue.
  *
@@ -1539,6 +1539,101 @@ int avfilter_compare_sign_bypath(char *signpath1, char *signpath2);
  */
 int avfilter_compare_sign_bybuff(uint8_t *signbuf1, int len1, uint8_t *signbuf2, int len2);
 
+/**
+ * Stop comparing signatures at the first matching segment instead of
+ * looking for the best one.
+ */
+#define AVFILTER_SIGN_COMPARE_FAST (1 << 0)
+
+/**
+ * compare two binary signatures in memory whether those matches or not.
+ *
+ * The buffers are parsed in place and are not modified, they may e.g. be
+ * mapped files. Nothing past the end of a buffer is read, so they do not
+ * need any padding. The fine signatures are only decoded when at least one
+ * pair of coarse signatures is similar enough, so mismatches are usually
+ * rejected early.
+ *
+ * @param signbuf1        the first binary signature.
+ * @param len1            the length of the first signature in bytes.
+ * @param signbuf2        the second binary signature.
+ * @param len2            the length of the second signature in bytes.
+ * @param flags           a combination of AVFILTER_SIGN_COMPARE_* flags.
+ * @return  <0: error, 0: no matching 1: partial matching 2: whole matching.
+ */
+int avfilter_compare_sign_bymem(const uint8_t *signbuf1, size_t len1,
+                                const uint8_t *signbuf2, size_t len2, int flags);
+
+/**
+ * compare the signature calculated so far by a signature filter instance
+ * against a binary signature in memory, with the thresholds the filter
+ * was configured with.
+ *
+ * This must not be called while the filter is processing a frame, e.g.
+ * call it from the thread driving the filter graph between two frames or
+ * once the graph has been flushed.
+ *
+ * @param ctx             a signature filter instance.
+ * @param input           index of the filter input to compare.
+ * @param signbuf         the binary signature, see avfilter_compare_sign_bymem().
+ * @param len             the length of the signature in bytes.
+ * @param flags           a combination of AVFILTER_SIGN_COMPARE_* flags.
+ * @return  <0: error, 0: no matching 1: partial matching 2: whole matching.
+ */
+int avfilter_compare_sign_byfilter(AVFilterContext *ctx, int input,
+                                   const uint8_t *signbuf, size_t len, int flags);
+
+/**
+ * A reference signature parsed once for comparing many signatures against
+ * it, e.g. several renditions of the same source.
+ */
+typedef struct AVFilterSignIndex AVFilterSignIndex;
+
+/**
+ * Parse a binary signature into a new index.
+ *
+ * The buffer is not referenced after this returns.
+ *
+ * @param index           the new index is returned here.
+ * @param signbuf         the reference binary signature.
+ * @param len             the length of the signature in bytes.
+ * @return  0 on success, a negative AVERROR on failure.
+ */
+int avfilter_sign_index_alloc(AVFilterSignIndex **index, const uint8_t *signbuf, size_t len);
+
+/**
+ * Free an index and set the pointer to NULL.
+ */
+void avfilter_sign_index_free(AVFilterSignIndex **index);
+
+/**
+ * compare a binary signature against the reference of an index, which is
+ * the first signature in terms of avfilter_compare_sign_bymem().
+ *
+ * An index is never modified by comparisons, so this may be called
+ * concurrently from several threads with the same index.
+ *
+ * @return  <0: error, 0: no matching 1: partial matching 2: whole matching.
+ */
+int avfilter_sign_index_compare(const AVFilterSignIndex *index,
+                                const uint8_t *signbuf, size_t len, int flags);
+
+/**
+ * compare nb binary signatures against the reference of an index.
+ *
+ * @param signbufs        nb binary signatures.
+ * @param lens            the lengths of the nb signatures in bytes.
+ * @param results         the result of avfilter_sign_index_compare() for
+ *                        each of the nb signatures is stored here.
+ * @param flags           a combination of AVFILTER_SIGN_COMPARE_* flags.
+ * @param nb_threads      number of threads to compare with, 0 to pick it
+ *                        from the number of CPUs.
+ * @return  0 if all results were written, a negative AVERROR otherwise.
+ */
+int avfilter_sign_index_compare_many(const AVFilterSignIndex *index,
+                                     const uint8_t * const *signbufs, const size_t *lens,
+                                     int *results, int nb, int flags, int nb_threads);
+
 /**
  * @}
  */
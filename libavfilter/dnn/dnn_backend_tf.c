@@ -40,6 +40,7 @@ typedef struct TFOptions{
     uint8_t async;
     uint32_t nireq;
     int device_id;
+    int batch_size;
 } TFOptions;
 
 typedef struct TFContext {
@@ -73,7 +74,8 @@ typedef struct TFInferRequest {
 
 typedef struct TFRequestItem {
     TFInferRequest *infer_request;
-    LastLevelTaskItem *lltask;
+    LastLevelTaskItem **lltasks;
+    uint32_t lltask_count;
     TF_Status *status;
     DNNAsyncExecModule exec_module;
 } TFRequestItem;
@@ -83,6 +85,7 @@ typedef struct TFRequestItem {
 static const AVOption dnn_tensorflow_options[] = {
     { "sess_config", "config for SessionOptions", OFFSET(options.sess_config), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
     { "device_id", "config for SessionOptions", OFFSET(options.device_id), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 255, FLAGS },
+    { "batch_size", "batch size per request", OFFSET(options.batch_size), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 1000, FLAGS },
     DNN_BACKEND_COMMON_OPTIONS
     { NULL }
 };
@@ -158,7 +161,7 @@ static int tf_start_inference(void *args)
 {
     TFRequestItem *request = args;
     TFInferRequest *infer_request = request->infer_request;
-    LastLevelTaskItem *lltask = request->lltask;
+    LastLevelTaskItem *lltask = request->lltasks[0];
     TaskItem *task = lltask->task;
     TFModel *tf_model = task->model;
 
@@ -192,7 +195,9 @@ static inline void destroy_request_item(TFRequestItem **arg) {
     request = *arg;
     tf_free_request(request->infer_request);
     av_freep(&request->infer_request);
-    av_freep(&request->lltask);
+    for (uint32_t i = 0; i < request->lltask_count; i++)
+        av_freep(&request->lltasks[i]);
+    av_freep(&request->lltasks);
     TF_DeleteStatus(request->status);
     ff_dnn_async_module_cleanup(&request->exec_module);
     av_freep(arg);
@@ -252,11 +257,11 @@ static TF_Buffer *read_graph(TFModel *tf_model, const char *model_filename)
     return graph_buf;
 }
 
-static TF_Tensor *allocate_input_tensor(TFModel *tf_model, const DNNData *input)
+static TF_Tensor *allocate_input_tensor(TFModel *tf_model, const DNNData *input, int batch_size)
 {
     TF_DataType dt;
     size_t size;
-    int64_t input_dims[] = {1, input->height, input->width, input->channels};
+    int64_t input_dims[] = {batch_size, input->height, input->width, input->channels};
     switch (input->dt) {
     case DNN_FLOAT:
         dt = TF_FLOAT;
@@ -271,7 +276,7 @@ static TF_Tensor *allocate_input_tensor(TFModel *tf_model, const DNNData *input)
     }
 
     return tf_model->tffns->TF_AllocateTensor(dt, input_dims, 4,
-                             input_dims[1] * input_dims[2] * input_dims[3] * size);
+                             input_dims[0] * input_dims[1] * input_dims[2] * input_dims[3] * size);
 }
 
 static int get_input_tf(void *model, DNNData *input, const char *input_name)
@@ -598,10 +603,17 @@ static DNNModel *dnn_load_model_tf(const char *model_filename, DNNFunctionType f
         if (!item) {
             goto err;
         }
-        item->lltask = NULL;
+        item->lltasks = av_malloc_array(ctx->options.batch_size, sizeof(*item->lltasks));
+        if (!item->lltasks) {
+            av_log(ctx, AV_LOG_ERROR, "Failed to allocate input tasks of TensorFlow request\n");
+            av_freep(&item);
+            goto err;
+        }
+        item->lltask_count = 0;
         item->infer_request = tf_create_inference_request();
         if (!item->infer_request) {
             av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for TensorFlow inference request\n");
+            av_freep(&item->lltasks);
             av_freep(&item);
             goto err;
         }
@@ -644,12 +656,14 @@ static int fill_model_input_tf(TFModel *tf_model, TFRequestItem *request) {
     TaskItem *task;
     TFInferRequest *infer_request = NULL;
     TFContext *ctx = &tf_model->ctx;
+    size_t sample_size;
+    int batch_size;
     int ret = 0;
 
-    lltask = ff_queue_pop_front(tf_model->lltask_queue);
+    lltask = ff_queue_peek_front(tf_model->lltask_queue);
     av_assert0(lltask);
     task = lltask->task;
-    request->lltask = lltask;
+    request->lltask_count = 0;
 
     ret = get_input_tf(tf_model, &input, task->input_name);
     if (ret != 0) {
@@ -675,30 +689,46 @@ static int fill_model_input_tf(TFModel *tf_model, TFRequestItem *request) {
     }
     infer_request->tf_input->index = 0;
 
-    infer_request->input_tensor = allocate_input_tensor(&input);
+    // frames of one batch share the input tensor, so they must have the same size
+    batch_size = FFMIN(ff_queue_size(tf_model->lltask_queue), ctx->options.batch_size);
+    infer_request->input_tensor = allocate_input_tensor(tf_model, &input, batch_size);
     if (!infer_request->input_tensor){
         av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for input tensor\n");
         ret = AVERROR(ENOMEM);
         goto err;
     }
     input.data = (float *)TF_TensorData(infer_request->input_tensor);
+    sample_size = TF_TensorByteSize(infer_request->input_tensor) / batch_size;
 
-    switch (tf_model->model->func_type) {
-    case DFT_PROCESS_FRAME:
-        if (task->do_ioproc) {
-            if (tf_model->model->frame_pre_proc != NULL) {
-                tf_model->model->frame_pre_proc(task->in_frame, &input, tf_model->model->filter_ctx);
-            } else {
-                ff_proc_from_frame_to_dnn(task->in_frame, &input, ctx);
+    for (int i = 0; i < batch_size; i++) {
+        lltask = ff_queue_pop_front(tf_model->lltask_queue);
+        task = lltask->task;
+        request->lltasks[request->lltask_count++] = lltask;
+
+        if (task->in_frame->width != input.width || task->in_frame->height != input.height) {
+            av_log(ctx, AV_LOG_ERROR, "Frame size changed inside a batch\n");
+            ret = AVERROR(EINVAL);
+            goto err;
+        }
+
+        switch (tf_model->model->func_type) {
+        case DFT_PROCESS_FRAME:
+            if (task->do_ioproc) {
+                if (tf_model->model->frame_pre_proc != NULL) {
+                    tf_model->model->frame_pre_proc(task->in_frame, &input, tf_model->model->filter_ctx);
+                } else {
+                    ff_proc_from_frame_to_dnn(task->in_frame, &input, ctx);
+                }
             }
+            break;
+        case DFT_ANALYTICS_DETECT:
+            ff_frame_to_dnn_detect(task->in_frame, &input, ctx);
+            break;
+        default:
+            avpriv_report_missing_feature(ctx, "model function type %d", tf_model->model->func_type);
+            break;
         }
-        break;
-    case DFT_ANALYTICS_DETECT:
-        ff_frame_to_dnn_detect(task->in_frame, &input, ctx);
-        break;
-    default:
-        avpriv_report_missing_feature(ctx, "model function type %d", tf_model->model->func_type);
-        break;
+        input.data = (uint8_t *)input.data + sample_size;
     }
 
     infer_request->tf_outputs = av_malloc_array(task->nb_output, sizeof(TF_Output));
@@ -728,21 +758,26 @@ static int fill_model_input_tf(TFModel *tf_model, TFRequestItem *request) {
 
     return 0;
 err:
+    for (uint32_t i = 0; i < request->lltask_count; i++)
+        av_freep(&request->lltasks[i]);
+    request->lltask_count = 0;
     tf_free_request(infer_request);
     return ret;
 }
 
 static void infer_completion_callback(void *args) {
     TFRequestItem *request = args;
-    LastLevelTaskItem *lltask = request->lltask;
+    LastLevelTaskItem *lltask = request->lltasks[0];
     TaskItem *task = lltask->task;
     DNNData *outputs;
+    size_t *output_strides = NULL;
     TFInferRequest *infer_request = request->infer_request;
     TFModel *tf_model = task->model;
     TFContext *ctx = &tf_model->ctx;
 
     outputs = av_calloc(task->nb_output, sizeof(*outputs));
-    if (!outputs) {
+    output_strides = av_calloc(task->nb_output, sizeof(*output_strides));
+    if (!outputs || !output_strides) {
         av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for *outputs\n");
         goto err;
     }
@@ -753,36 +788,47 @@ static void infer_completion_callback(void *args) {
         outputs[i].channels = TF_Dim(infer_request->output_tensors[i], 3);
         outputs[i].data = TF_TensorData(infer_request->output_tensors[i]);
         outputs[i].dt = (DNNDataType)TF_TensorType(infer_request->output_tensors[i]);
-    }
-    switch (tf_model->model->func_type) {
-    case DFT_PROCESS_FRAME:
-        //it only support 1 output if it's frame in & frame out
-        if (task->do_ioproc) {
-            if (tf_model->model->frame_post_proc != NULL) {
-                tf_model->model->frame_post_proc(task->out_frame, outputs, tf_model->model->filter_ctx);
+        output_strides[i] = TF_TensorByteSize(infer_request->output_tensors[i]) / request->lltask_count;
+    }
+    for (uint32_t i = 0; i < request->lltask_count; ++i) {
+        task = request->lltasks[i]->task;
+        switch (tf_model->model->func_type) {
+        case DFT_PROCESS_FRAME:
+            //it only support 1 output if it's frame in & frame out
+            if (task->do_ioproc) {
+                if (tf_model->model->frame_post_proc != NULL) {
+                    tf_model->model->frame_post_proc(task->out_frame, outputs, tf_model->model->filter_ctx);
+                } else {
+                    ff_proc_from_dnn_to_frame(task->out_frame, outputs, ctx);
+                }
             } else {
-                ff_proc_from_dnn_to_frame(task->out_frame, outputs, ctx);
+                task->out_frame->width = outputs[0].width;
+                task->out_frame->height = outputs[0].height;
             }
-        } else {
-            task->out_frame->width = outputs[0].width;
-            task->out_frame->height = outputs[0].height;
-        }
-        break;
-    case DFT_ANALYTICS_DETECT:
-        if (!tf_model->model->detect_post_proc) {
-            av_log(ctx, AV_LOG_ERROR, "Detect filter needs provide post proc\n");
-            return;
+            break;
+        case DFT_ANALYTICS_DETECT:
+            if (!tf_model->model->detect_post_proc) {
+                av_log(ctx, AV_LOG_ERROR, "Detect filter needs provide post proc\n");
+                goto err;
+            }
+            tf_model->model->detect_post_proc(task->in_frame, outputs, task->nb_output, tf_model->model->filter_ctx);
+            break;
+        default:
+            av_log(ctx, AV_LOG_ERROR, "Tensorflow backend does not support this kind of dnn filter now\n");
+            goto err;
         }
-        tf_model->model->detect_post_proc(task->in_frame, outputs, task->nb_output, tf_model->model->filter_ctx);
-        break;
-    default:
-        av_log(ctx, AV_LOG_ERROR, "Tensorflow backend does not support this kind of dnn filter now\n");
-        goto err;
+        task->inference_done++;
+        av_freep(&request->lltasks[i]);
+        for (uint32_t j = 0; j < task->nb_output; ++j)
+            outputs[j].data = (uint8_t *)outputs[j].data + output_strides[j];
     }
-    task->inference_done++;
 err:
+    for (uint32_t i = 0; i < request->lltask_count; ++i)
+        av_freep(&request->lltasks[i]);
+    request->lltask_count = 0;
     tf_free_request(infer_request);
     av_freep(&outputs);
+    av_freep(&output_strides);
 
     if (ff_safe_queue_push_back(tf_model->request_queue, request) < 0) {
         destroy_request_item(&request);
@@ -875,6 +921,29 @@ static int dnn_execute_model_tf(const DNNModel *model, DNNExecBaseParams *exec_p
         return ret;
     }
 
+    if (ctx->options.async) {
+        // a request is only started once a full batch of frames is queued,
+        // dnn_flush_tf() runs the remaining partial batch
+        while (ff_queue_size(tf_model->lltask_queue) >= ctx->options.batch_size) {
+            request = ff_safe_queue_pop_front(tf_model->request_queue);
+            if (!request) {
+                av_log(ctx, AV_LOG_ERROR, "unable to get infer request.\n");
+                return AVERROR(EINVAL);
+            }
+
+            ret = execute_model_tf(request, tf_model->lltask_queue);
+            if (ret != 0) {
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    if (ctx->options.batch_size > 1) {
+        avpriv_report_missing_feature(ctx, "batch mode for sync execution");
+        return AVERROR(ENOSYS);
+    }
+
     request = ff_safe_queue_pop_front(tf_model->request_queue);
     if (!request) {
         av_freep(&task);
@@ -37,6 +37,10 @@
 #define SIGELEM_SIZE 380
 #define DIFFELEM_SIZE 348 /* SIGELEM_SIZE - elem_a1 - elem_a2 */
 #define COARSE_SIZE 90
+/* 380 ternary digits of a frame signature, two bits each */
+#define SIGNATURE_L1_WORDS 12
+/* bytes of one coarse signature bag of words, 243 bits used */
+#define SIGNATURE_BAG_SIZE 32
 
 enum lookup_mode {
     MODE_OFF,
@@ -77,15 +81,26 @@ typedef struct FineSignature {
     uint8_t confidence;
     uint8_t words[5];
     uint8_t framesig[SIGELEM_SIZE/5];
+    uint64_t l1code[SIGNATURE_L1_WORDS]; /* framesig as bit pairs, see fill_l1code() */
 } FineSignature;
 
 typedef struct CoarseSignature {
-    uint8_t data[5][31]; /* 5 words with min. 243 bit */
+    uint8_t data[5][SIGNATURE_BAG_SIZE]; /* 5 words with min. 243 bit, padded */
     struct FineSignature* first; /* associated Finesignatures */
     struct FineSignature* last;
     struct CoarseSignature* next;
 } CoarseSignature;
 
+/**
+ * Signatures are allocated in chunks which never move, so the list links
+ * stay valid and consecutive frames end up next to each other in memory.
+ */
+typedef struct SignatureArena {
+    uint8_t **chunks;
+    int nb_chunks;
+    int used; /* elements used in the last chunk */
+} SignatureArena;
+
 /* lookup types */
 typedef struct MatchingInfo {
     double meandist;
@@ -117,11 +132,23 @@ typedef struct StreamContext {
     CoarseSignature* curcoarsesig1;
     CoarseSignature* curcoarsesig2;
 
+    SignatureArena finearena;
+    SignatureArena coarsearena;
+
     int coarsecount; /* counter from 0 to 89 */
     int midcoarse;   /* whether it is a coarsesignature beginning from 45 + i * 90 */
     uint32_t lastindex; /* helper to store amount of frames */
 
     int exported; /* boolean whether stream already exported */
+
+    /* block geometry, depends only on the link configuration */
+    int rowstart[33]; /* first picture row of each of the 32 block rows */
+    int colstart[33]; /* first picture column of each of the 32 block columns */
+    int32_t rowweight[32];
+    int32_t colweight[32];
+    int64_t blocksize; /* product of both possible block heights and widths */
+    uint16_t *colsums; /* column sums, one line of colsums_stride per job */
+    int colsums_stride;
 } StreamContext;
 
 typedef struct SignatureContext {
@@ -136,9 +163,12 @@ typedef struct SignatureContext {
     int thl1;
     int thdi;
     int thit;
+    int segment_frames;
     /* end input parameters */
 
-    uint8_t l1distlut[243*242/2]; /* 243 + 242 + 241 ... */
+    int segmented;   /* whether the signature is exported in segments */
+    int nb_segments; /* number of segments exported so far */
+
     StreamContext* streamcontexts;
 } SignatureContext;
 
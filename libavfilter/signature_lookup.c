@@ -37,74 +37,84 @@
 #define STATUS_END_REACHED 1
 #define STATUS_BEGIN_REACHED 2
 
-static void fill_l1distlut(uint8_t lut[])
+#define FINE_CHUNK_SIZE 512
+#define COARSE_CHUNK_SIZE 64
+
+/**
+ * get a zeroed element of elem_size bytes from the arena
+ */
+static void *arena_alloc(SignatureArena *arena, size_t elem_size, int chunk_size)
 {
-    int i, j, tmp_i, tmp_j,count;
-    uint8_t dist;
-
-    for (i = 0, count = 0; i < 242; i++) {
-        for (j = i + 1; j < 243; j++, count++) {
-            /* ternary distance between i and j */
-            dist = 0;
-            tmp_i = i; tmp_j = j;
-            do {
-                dist += FFABS((tmp_j % 3) - (tmp_i % 3));
-                tmp_j /= 3;
-                tmp_i /= 3;
-            } while (tmp_i > 0 || tmp_j > 0);
-            lut[count] = dist;
+    if (!arena->nb_chunks || arena->used == chunk_size) {
+        uint8_t *chunk = av_calloc(chunk_size, elem_size);
+        if (!chunk)
+            return NULL;
+        if (av_dynarray_add_nofree(&arena->chunks, &arena->nb_chunks, chunk) < 0) {
+            av_free(chunk);
+            return NULL;
         }
+        arena->used = 0;
     }
+    return arena->chunks[arena->nb_chunks - 1] + elem_size * arena->used++;
 }
 
-static unsigned int intersection_word(const uint8_t *first, const uint8_t *second)
+static void arena_free(SignatureArena *arena)
 {
-    unsigned int val=0,i;
-    for (i = 0; i < 28; i += 4) {
-        val += av_popcount( (first[i]   & second[i]  ) << 24 |
-                            (first[i+1] & second[i+1]) << 16 |
-                            (first[i+2] & second[i+2]) << 8  |
-                            (first[i+3] & second[i+3]) );
-    }
-    val += av_popcount( (first[28] & second[28]) << 16 |
-                        (first[29] & second[29]) << 8  |
-                        (first[30] & second[30]) );
-    return val;
+    for (int i = 0; i < arena->nb_chunks; i++)
+        av_freep(&arena->chunks[i]);
+    av_freep(&arena->chunks);
+    arena->nb_chunks = 0;
+    arena->used = 0;
 }
 
-static unsigned int union_word(const uint8_t *first, const uint8_t *second)
+static FineSignature *alloc_finesignature(StreamContext *sc)
 {
-    unsigned int val=0,i;
-    for (i = 0; i < 28; i += 4) {
-        val += av_popcount( (first[i]   | second[i]  ) << 24 |
-                            (first[i+1] | second[i+1]) << 16 |
-                            (first[i+2] | second[i+2]) << 8  |
-                            (first[i+3] | second[i+3]) );
-    }
-    val += av_popcount( (first[28] | second[28]) << 16 |
-                        (first[29] | second[29]) << 8  |
-                        (first[30] | second[30]) );
-    return val;
+    return arena_alloc(&sc->finearena, sizeof(FineSignature), FINE_CHUNK_SIZE);
 }
 
-static unsigned int get_l1dist(AVFilterContext *ctx, SignatureContext *sc, const uint8_t *first, const uint8_t *second)
+static CoarseSignature *alloc_coarsesignature(StreamContext *sc)
 {
-    unsigned int i;
-    unsigned int dist = 0;
-    uint8_t f, s;
-
-    for (i = 0; i < SIGELEM_SIZE/5; i++) {
-        if (first[i] != second[i]) {
-            f = first[i];
-            s = second[i];
-            if (f > s) {
-                /* little variation of gauss sum formula */
-                dist += sc->l1distlut[243*242/2 - (243-s)*(242-s)/2 + f - s - 1];
-            } else {
-                dist += sc->l1distlut[243*242/2 - (243-f)*(242-f)/2 + s - f - 1];
-            }
+    return arena_alloc(&sc->coarsearena, sizeof(CoarseSignature), COARSE_CHUNK_SIZE);
+}
+
+/**
+ * free all signatures of a stream built by the filter
+ */
+static void free_signatures(StreamContext *sc)
+{
+    arena_free(&sc->finearena);
+    arena_free(&sc->coarsearena);
+    sc->finesiglist = NULL;
+    sc->curfinesig = NULL;
+    sc->coarsesiglist = NULL;
+    sc->coarseend = NULL;
+    sc->curcoarsesig1 = NULL;
+    sc->curcoarsesig2 = NULL;
+}
+
+/**
+ * expand the ternary digits t of the frame signature to the bit pairs
+ * (t > 0, t > 1), so the L1 distance of two frame signatures is the number
+ * of bits in which their codes differ
+ */
+static void fill_l1code(FineSignature *fs)
+{
+    memset(fs->l1code, 0, sizeof(fs->l1code));
+    for (int i = 0, bit = 0; i < SIGELEM_SIZE/5; i++) {
+        unsigned int v = fs->framesig[i];
+        for (int j = 0; j < 5; j++, v /= 3, bit += 2) {
+            unsigned int t = v % 3;
+            fs->l1code[bit >> 6] |= (uint64_t)((t > 0) | (t > 1) << 1) << (bit & 63);
         }
     }
+}
+
+static unsigned int get_l1dist(SignatureContext *sc, const FineSignature *first, const FineSignature *second)
+{
+    unsigned int dist = 0;
+
+    for (int i = 0; i < SIGNATURE_L1_WORDS; i++)
+        dist += av_popcount64(first->l1code[i] ^ second->l1code[i]);
     return dist;
 }
 
@@ -115,9 +125,17 @@ static unsigned int get_l1dist(AVFilterContext *ctx, SignatureContext *sc, const
 static int get_jaccarddist(SignatureContext *sc, CoarseSignature *first, CoarseSignature *second)
 {
     int jaccarddist, i, composdist = 0, cwthcount = 0;
+
     for (i = 0; i < 5; i++) {
-        if ((jaccarddist = intersection_word(first->data[i], second->data[i])) > 0) {
-            jaccarddist /= union_word(first->data[i], second->data[i]);
+        int inter = 0, uni = 0;
+
+        for (int j = 0; j < SIGNATURE_BAG_SIZE; j += 8) {
+            uint64_t a = AV_RN64(first->data[i] + j), b = AV_RN64(second->data[i] + j);
+            inter += av_popcount64(a & b);
+            uni   += av_popcount64(a | b);
+        }
+        if ((jaccarddist = inter) > 0) {
+            jaccarddist /= uni;
         }
         if (jaccarddist >= sc->thworddist) {
             if (++cwthcount > 2) {
@@ -213,7 +231,7 @@ static MatchingInfo* get_matching_parameters(AVFilterContext *ctx, SignatureCont
         pairs[i].a = f;
         for (j = 0, s = second; j < COARSE_SIZE && s->next; j++, s = s->next) {
             /* l1 distance of finesignature */
-            l1dist = get_l1dist(ctx, sc, f->framesig, s->framesig);
+            l1dist = get_l1dist(sc, f, s);
             if (l1dist < sc->thl1) {
                 if (l1dist < pairs[i].dist) {
                     pairs[i].size = 1;
@@ -429,7 +447,7 @@ static MatchingInfo evaluate_parameters(AVFilterContext *ctx, SignatureContext *
         b = infos->second;
         if (a == NULL || b == NULL) continue;
         while (1) {
-            dist = get_l1dist(ctx, sc, a->framesig, b->framesig);
+            dist = get_l1dist(sc, a, b);
 
             if (dist > sc->thl1) {
                 if (a->confidence >= 1 || b->confidence >= 1) {
@@ -547,8 +565,6 @@ static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc
     bestmatch.meandist = 99999;
     bestmatch.whole = 0;
 
-    fill_l1distlut(sc->l1distlut);
-
     /* stage 1: coarsesignature matching */
     if (find_next_coarsecandidate(sc, second->coarsesiglist, &cs, &cs2, 1) == 0)
         return bestmatch; /* no candidate found */
@@ -707,6 +723,7 @@ static int calc_signature(AVFilterContext *ctx, StreamContext *sc, FineSignature
         av_freep(&elemsignature);
         av_freep(&sortsignature);
     }
+    fill_l1code(fs);
 
     /* confidence */
     qsort(conflist, DIFFELEM_SIZE, sizeof(uint64_t), cmp);
@@ -715,7 +732,7 @@ static int calc_signature(AVFilterContext *ctx, StreamContext *sc, FineSignature
     /* coarsesignature */
     if (sc->coarsecount == 0) {
         if (sc->curcoarsesig2) {
-            sc->curcoarsesig1 = av_mallocz(sizeof(CoarseSignature));
+            sc->curcoarsesig1 = alloc_coarsesignature(sc);
             if (!sc->curcoarsesig1)
                 return AVERROR(ENOMEM);
             sc->curcoarsesig1->first = fs;
@@ -725,7 +742,7 @@ static int calc_signature(AVFilterContext *ctx, StreamContext *sc, FineSignature
     }
     if (sc->coarsecount == 45) {
         sc->midcoarse = 1;
-        sc->curcoarsesig2 = av_mallocz(sizeof(CoarseSignature));
+        sc->curcoarsesig2 = alloc_coarsesignature(sc);
         if (!sc->curcoarsesig2)
             return AVERROR(ENOMEM);
         sc->curcoarsesig2->first = fs;
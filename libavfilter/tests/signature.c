@@ -0,0 +1,313 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/common.h"
+#include "libavutil/file.h"
+#include "libavutil/file_open.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavfilter/avfilter.h"
+
+/* sign a test source and write its binary signature to filename, or only run
+ * src if it signs the source itself */
+static int sign_source(const char *src, const char *filename)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    char desc[1024];
+    int ret;
+
+    if (!graph)
+        return AVERROR(ENOMEM);
+
+    if (filename)
+        snprintf(desc, sizeof(desc),
+                 "%s,signature=format=binary:filename=%s,nullsink", src, filename);
+    else
+        snprintf(desc, sizeof(desc), "%s,nullsink", src);
+    if ((ret = avfilter_graph_parse_ptr(graph, desc, NULL, NULL, NULL)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    do {
+        ret = avfilter_graph_request_oldest(graph);
+    } while (ret >= 0 || ret == AVERROR(EAGAIN));
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+/**
+ * Return a copy of buf that ends exactly at a page boundary, followed by a
+ * page that cannot be accessed, so any read past the end faults.
+ */
+static uint8_t *guarded_copy(const uint8_t *buf, size_t len, void **map, size_t *map_size)
+{
+#if HAVE_MMAP && HAVE_SYSCONF
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (len + page - 1) / page * page;
+    uint8_t *ptr;
+    int fd = avpriv_open("/dev/zero", O_RDWR);
+
+    if (fd < 0)
+        return NULL;
+    ptr = mmap(NULL, size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return NULL;
+    if (mprotect(ptr + size, page, PROT_NONE) < 0) {
+        munmap(ptr, size + page);
+        return NULL;
+    }
+    *map      = ptr;
+    *map_size = size + page;
+    ptr += size - len;
+#else
+    uint8_t *ptr = av_malloc(len);
+    if (!ptr)
+        return NULL;
+    *map      = ptr;
+    *map_size = 0;
+#endif
+    memcpy(ptr, buf, len);
+    return ptr;
+}
+
+static int sign_testsrc(const char *filename)
+{
+    return sign_source("testsrc=d=4:s=64x48:r=25", filename);
+}
+
+static const char *const index_sources[] = {
+    "testsrc=d=4:s=64x48:r=25",
+    "testsrc=d=4:s=64x48:r=25,trim=start_frame=25",
+    "testsrc=d=4:s=64x48:r=25,hflip",
+    "testsrc2=d=4:s=64x48:r=25",
+    "testsrc=d=4:s=64x48:r=25,trim=end_frame=40",
+};
+
+#define NB_INDEX_SOURCES FF_ARRAY_ELEMS(index_sources)
+
+/**
+ * Compare signatures of several sources through indexes and check that
+ * every result equals the one of avfilter_compare_sign_bymem().
+ */
+static int test_index(const char *filename)
+{
+    uint8_t *sigs[NB_INDEX_SOURCES] = { NULL };
+    size_t lens[NB_INDEX_SOURCES];
+    int results[NB_INDEX_SOURCES];
+    AVFilterSignIndex *index = NULL;
+    int ret = 0, mismatches = 0;
+
+    for (int i = 0; i < NB_INDEX_SOURCES; i++) {
+        uint8_t *file;
+
+        if ((ret = sign_source(index_sources[i], filename)) < 0 ||
+            (ret = av_file_map(filename, &file, &lens[i], 0, NULL)) < 0)
+            goto end;
+        sigs[i] = av_memdup(file, lens[i]);
+        av_file_unmap(file, lens[i]);
+        if (!sigs[i]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+
+    /* one query against an index of each reference */
+    for (int i = 0; i < NB_INDEX_SOURCES; i++) {
+        int ref;
+
+        if ((ret = avfilter_sign_index_alloc(&index, sigs[i], lens[i])) < 0)
+            goto end;
+        ref = avfilter_compare_sign_bymem(sigs[i], lens[i], sigs[1], lens[1], 0);
+        ret = avfilter_sign_index_compare(index, sigs[1], lens[1], 0);
+        printf("index %d: %d\n", i, ret);
+        mismatches += ret != ref;
+        avfilter_sign_index_free(&index);
+    }
+
+    /* every signature against the index of each reference at once */
+    for (int i = 0; i < NB_INDEX_SOURCES; i++) {
+        if ((ret = avfilter_sign_index_alloc(&index, sigs[i], lens[i])) < 0 ||
+            (ret = avfilter_sign_index_compare_many(index, (const uint8_t * const *)sigs,
+                                                    lens, results, NB_INDEX_SOURCES,
+                                                    0, 2)) < 0)
+            goto end;
+        printf("many %d:", i);
+        for (int j = 0; j < NB_INDEX_SOURCES; j++) {
+            int ref = avfilter_compare_sign_bymem(sigs[i], lens[i], sigs[j], lens[j], 0);
+            printf(" %d", results[j]);
+            mismatches += results[j] != ref;
+        }
+        printf("\n");
+        avfilter_sign_index_free(&index);
+    }
+
+    printf("index mismatches: %d\n", mismatches);
+    ret = mismatches ? AVERROR_BUG : 0;
+end:
+    avfilter_sign_index_free(&index);
+    for (int i = 0; i < NB_INDEX_SOURCES; i++)
+        av_free(sigs[i]);
+    return ret;
+}
+
+#define SEGMENT_SOURCE "testsrc=d=48:s=64x48:r=25"
+
+/* frame ranges of the segments written by test_segments() */
+static const int segment_bounds[] = { 0, 25, 565, 1105, 1200 };
+
+static void log_segments(void *avcl, int level, const char *fmt, va_list vl)
+{
+    if (!strncmp(fmt, "Exported segment", 16))
+        vprintf(fmt, vl);
+    else
+        av_log_default_callback(avcl, level, fmt, vl);
+}
+
+static int file_equal(const char *filename1, const char *filename2)
+{
+    uint8_t *buf1, *buf2;
+    size_t len1, len2;
+    int ret;
+
+    if ((ret = av_file_map(filename1, &buf1, &len1, 0, NULL)) < 0)
+        return ret;
+    if ((ret = av_file_map(filename2, &buf2, &len2, 0, NULL)) < 0) {
+        av_file_unmap(buf1, len1);
+        return ret;
+    }
+    ret = len1 == len2 && !memcmp(buf1, buf2, len1);
+    av_file_unmap(buf1, len1);
+    av_file_unmap(buf2, len2);
+    return ret;
+}
+
+/**
+ * Sign a stream in segments, ended by segment_frames and by the segment
+ * command, and check that every segment equals the signature of its frames
+ * cut out of the stream. The filter logs the signature chunks it keeps
+ * after each segment, which shows that the memory is released.
+ */
+static int test_segments(const char *filename)
+{
+    char desc[1024], pattern[512], segment[512], whole[512];
+    int ret;
+
+    snprintf(pattern, sizeof(pattern), "%s.seg%%d", filename);
+    snprintf(whole, sizeof(whole), "%s.whole", filename);
+    snprintf(desc, sizeof(desc),
+             SEGMENT_SOURCE ",sendcmd=c='1.0 signature segment',"
+             "signature=format=binary:segment_frames=540:filename=%s", pattern);
+
+    av_log_set_callback(log_segments);
+    ret = sign_source(desc, NULL);
+    av_log_set_callback(av_log_default_callback);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i + 1 < FF_ARRAY_ELEMS(segment_bounds); i++) {
+        snprintf(desc, sizeof(desc), SEGMENT_SOURCE ",trim=start_frame=%d:end_frame=%d",
+                 segment_bounds[i], segment_bounds[i + 1]);
+        snprintf(segment, sizeof(segment), "%s.seg%d", filename, i);
+        if ((ret = sign_source(desc, whole)) < 0 ||
+            (ret = file_equal(segment, whole)) < 0)
+            return ret;
+        printf("segment %d, frames %d-%d: %s\n", i, segment_bounds[i],
+               segment_bounds[i + 1] - 1, ret ? "equal" : "different");
+        if (!ret)
+            return AVERROR_BUG;
+    }
+    return 0;
+}
+
+static void guarded_free(void *map, size_t map_size)
+{
+#if HAVE_MMAP && HAVE_SYSCONF
+    munmap(map, map_size);
+#else
+    av_free(map);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = argc > 1 ? argv[1] : "signature.bin";
+    uint8_t *file, *sig, *cut;
+    void *map, *cut_map;
+    size_t len, map_size, cut_map_size;
+    int ret;
+
+    if (argc > 2 && !strcmp(argv[2], "segments")) {
+        if (test_segments(filename) < 0) {
+            fprintf(stderr, "Segmented export failed\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if ((ret = sign_testsrc(filename)) < 0 ||
+        (ret = av_file_map(filename, &file, &len, 0, NULL)) < 0) {
+        fprintf(stderr, "Could not sign the test source\n");
+        return 1;
+    }
+
+    sig = guarded_copy(file, len, &map, &map_size);
+    av_file_unmap(file, len);
+    if (!sig)
+        return 1;
+
+    printf("whole: %d\n", avfilter_compare_sign_bymem(sig, len, sig, len, 0));
+    printf("whole fast: %d\n",
+           avfilter_compare_sign_bymem(sig, len, sig, len, AVFILTER_SIGN_COMPARE_FAST));
+
+    /* truncated signatures, each one ending right before the guard page */
+    for (size_t cut_len = 1; cut_len < len; cut_len += cut_len < 64 ? 1 : 97) {
+        cut = guarded_copy(sig, cut_len, &cut_map, &cut_map_size);
+        if (!cut)
+            break;
+        ret = avfilter_compare_sign_bymem(sig, len, cut, cut_len, 0);
+        printf("%zu: %d\n", cut_len, ret < 0 ? -1 : ret);
+        guarded_free(cut_map, cut_map_size);
+    }
+
+    guarded_free(map, map_size);
+
+    if (test_index(filename) < 0) {
+        fprintf(stderr, "Index comparisons failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -23,28 +23,94 @@
  * Filter implementing livepeer scene classification.
  */
 
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "avfilter.h"
+#include "filters.h"
 #include "video.h"
 #include "formats.h"
 #include "internal.h"
+#include "libavutil/avstring.h"
+#include "libavutil/classification_scores.h"
+#include "libavutil/fifo.h"
+#include "libavutil/file_open.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/time.h"
 #include "libavformat/avio.h"
 #include "libswscale/swscale.h"
 #include "dnn_filter_common.h"
 
 typedef enum {DNN_SUCCESS, DNN_ERROR} DNNReturnType;
 
+#define RINGLOG_MAGIC   MKTAG('L', 'P', 'R', 'L')
+#define RINGLOG_VERSION 1
+
+/**
+ * Header of the ring log file, followed by nb_entries records of
+ * entry_size bytes each: a RingLogEntry and nb_scores floats.
+ */
+typedef struct RingLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t nb_entries;
+    uint32_t nb_scores;
+    uint32_t reserved;
+    atomic_uint_least64_t head; ///< Number of records written so far
+} RingLogHeader;
+
+typedef struct RingLogEntry {
+    atomic_uint_least64_t seq;  ///< Record number + 1, 0 while the record is being written
+    int64_t pts;                ///< Frame timestamp in microseconds
+    int32_t top_class;
+    uint32_t reserved;
+} RingLogEntry;
+
+typedef struct LivepeerPendingFrame {
+    AVFrame *frame;
+    int sampled;               ///< Frame is classified, as opposed to inheriting the last result
+} LivepeerPendingFrame;
+
 typedef struct LivepeerContext {
     const AVClass *class;
 
     DnnContext dnnctx;         ///< DNN model, backend, I/O layer names
     int input_width, input_height, output_width, output_height;      ///< Model input and output dimensions, initialized after the model is loaded
     struct SwsContext *sws_rgb_scale; ///< Used for scaling image to DNN input size and pixel format (RGB24)
-    struct AVFrame *swscaleframe;  ///< Scaled image
+    int sws_src_width, sws_src_height; ///< Source geometry sws_rgb_scale was built for
+    enum AVPixelFormat sws_src_format; ///< Source pixel format sws_rgb_scale was built for
     FILE *logfile;       ///< (Optional) Log classification probabilities in this file
     char *log_filename;  ///< File name
+
+    int interval;              ///< Classify every interval-th frame
+    int64_t time_interval;     ///< Minimum time between classified frames, 0 to sample by frame count
+    int batch_size;            ///< Number of sampled frames classified by one model call
+    int64_t nb_frames;         ///< Number of input frames seen so far
+    int64_t last_sample_time;  ///< Time of the last sampled frame in AV_TIME_BASE units
+    AVFifo *free_scaled;       ///< Scaled images that are not used by an inference in flight
+    int nb_inflight;           ///< Number of sampled frames submitted to the model and not yet classified
+    int nb_done;               ///< Number of classified frames still held in pending
+    AVFifo *pending;           ///< Frames held back until the classification they depend on is done
+    AVDictionary *last_result; ///< Classification carried forward to frames that are not sampled
+    AVBufferRef *last_scores;  ///< Side data carried forward to frames that are not sampled
+
+    char *model_id;            ///< Model identifier exported with the scores
+    int export_metadata;       ///< Also export the scores as metadata strings
+    char *ringlog_filename;    ///< (Optional) Binary ring log of the scores
+    int ringlog_entries;       ///< Number of records in the ring log
+    RingLogHeader *ringlog;    ///< Mapped ring log
+    size_t ringlog_size;       ///< Size of the mapping
 } LivepeerContext;
 
 
@@ -67,23 +133,52 @@ static const AVOption livepeer_options[] = {
     {"backend_configs", "backend configs", OFFSET(dnnctx.backend_options), AV_OPT_TYPE_STRING,
      {.str = "sess_config=0x01200232"}, 0, 0, FLAGS},
     {"logfile", "path to logfile", OFFSET(log_filename), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS},
+    {"interval", "classify every Nth frame", OFFSET(interval), AV_OPT_TYPE_INT, {.i64 = 1}, 1, INT_MAX, FLAGS},
+    {"time_interval", "minimum time between classified frames", OFFSET(time_interval), AV_OPT_TYPE_DURATION,
+     {.i64 = 0}, 0, INT64_MAX, FLAGS},
+    {"batch_size", "number of sampled frames classified by one model call", OFFSET(batch_size), AV_OPT_TYPE_INT,
+     {.i64 = 1}, 1, 1000, FLAGS},
+    {"model_id", "model identifier exported with the scores", OFFSET(model_id), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS},
+    {"metadata", "export the scores as frame metadata strings", OFFSET(export_metadata), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"ringlog", "path to binary ring log", OFFSET(ringlog_filename), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS},
+    {"ringlog_entries", "number of records in the ring log", OFFSET(ringlog_entries), AV_OPT_TYPE_INT,
+     {.i64 = 4096}, 1, INT_MAX, FLAGS},
     {NULL}
 };
 
 AVFILTER_DEFINE_CLASS(livepeer);
 
+static void ringlog_write(AVFilterContext *context, const AVFrame *frame,
+                          const float *scores, int nb_scores, int top_class)
+{
+    LivepeerContext *ctx = context->priv;
+    RingLogHeader *header = ctx->ringlog;
+    uint64_t pos = atomic_fetch_add_explicit(&header->head, 1, memory_order_relaxed);
+    RingLogEntry *entry = (RingLogEntry *)((uint8_t *)(header + 1) +
+                                           (pos % header->nb_entries) * header->entry_size);
+    float *dst = (float *)(entry + 1);
+
+    // Readers copy a record and check that seq did not change meanwhile.
+    atomic_store_explicit(&entry->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    entry->pts = frame->pts == AV_NOPTS_VALUE ? AV_NOPTS_VALUE :
+                 av_rescale_q(frame->pts, context->inputs[0]->time_base, AV_TIME_BASE_Q);
+    entry->top_class = top_class;
+    nb_scores = FFMIN(nb_scores, header->nb_scores);
+    memcpy(dst, scores, nb_scores * sizeof(*dst));
+    memset(dst + nb_scores, 0, (header->nb_scores - nb_scores) * sizeof(*dst));
+
+    atomic_store_explicit(&entry->seq, pos + 1, memory_order_release);
+}
+
 static int post_proc(AVFrame *out, DNNData *dnn_output, AVFilterContext *context)
 {
     LivepeerContext *ctx = context->priv;
     float *pfdata = dnn_output->data;
     int lendata = dnn_output->height;
-    char slvpinfo[256] = {0,};
-    char tokeninfo[64] = {0,};
-    char topcatidx_str[8] = {0,};
-    char topcatprob_str[8] = {0,};
-    AVDictionary **metadata = &out->metadata;
+    AVClassificationScores *scores;
 
-    // need all inference probability as metadata
     int topcatidx = -1;
     float topcatprob = 0;
     for (int i = 0; i < lendata; i++) {
@@ -91,16 +186,41 @@ static int post_proc(AVFrame *out, DNNData *dnn_output, AVFilterContext *context
             topcatprob = pfdata[i];
             topcatidx = i;
         }
-        snprintf(tokeninfo, sizeof(tokeninfo), "%.5f,", pfdata[i]);
-        strcat(slvpinfo, tokeninfo);
     }
-    snprintf(topcatprob_str, sizeof(topcatprob_str), "%.5f,", topcatprob);
-    snprintf(topcatidx_str, sizeof(topcatidx_str), "%d", topcatidx);
 
-    if (lendata > 0) {
-        av_dict_set(metadata, "lavfi.lvpdnn.text", slvpinfo, 0);
-        av_dict_set(metadata, "lavfi.lvpdnn.top_cat", topcatidx_str, 0);
-        av_dict_set(metadata, "lavfi.lvpdnn.top_prob", topcatprob_str, 0);
+    if (lendata <= 0)
+        return DNN_SUCCESS;
+
+    scores = av_classification_scores_create_side_data(out, lendata);
+    if (!scores)
+        return DNN_ERROR;
+    av_strlcpy(scores->model_id, ctx->model_id, sizeof(scores->model_id));
+    scores->top_class = topcatidx;
+    memcpy(av_classification_scores_get(scores), pfdata, lendata * sizeof(*pfdata));
+
+    if (ctx->ringlog)
+        ringlog_write(context, out, pfdata, lendata, topcatidx);
+
+    // text output is kept for existing consumers, it is not needed otherwise
+    if (ctx->export_metadata || ctx->logfile) {
+        char slvpinfo[256] = {0,};
+        char tokeninfo[64] = {0,};
+        char topcatidx_str[8] = {0,};
+        char topcatprob_str[8] = {0,};
+        AVDictionary **metadata = &out->metadata;
+
+        for (int i = 0; i < lendata; i++) {
+            snprintf(tokeninfo, sizeof(tokeninfo), "%.5f,", pfdata[i]);
+            strcat(slvpinfo, tokeninfo);
+        }
+        snprintf(topcatprob_str, sizeof(topcatprob_str), "%.5f,", topcatprob);
+        snprintf(topcatidx_str, sizeof(topcatidx_str), "%d", topcatidx);
+
+        if (ctx->export_metadata) {
+            av_dict_set(metadata, "lavfi.lvpdnn.text", slvpinfo, 0);
+            av_dict_set(metadata, "lavfi.lvpdnn.top_cat", topcatidx_str, 0);
+            av_dict_set(metadata, "lavfi.lvpdnn.top_prob", topcatprob_str, 0);
+        }
         if (ctx->logfile != NULL) {
             fprintf(ctx->logfile, "%s\n", slvpinfo);
         }
@@ -108,45 +228,83 @@ static int post_proc(AVFrame *out, DNNData *dnn_output, AVFilterContext *context
     return DNN_SUCCESS;
 }
 
-static int pre_proc(AVFrame *frame, DNNData *input, AVFilterContext *log_ctx)
+static int pre_proc(AVFrame *frame, DNNData *input, AVFilterContext *filter_ctx)
 {
-    struct SwsContext *sws_ctx;
+    const uint8_t *src = frame->data[0];
+    float *dst = input->data;
+    const int len = frame->width * 3;
+
     if (input->dt != DNN_FLOAT) {
-        avpriv_report_missing_feature(log_ctx, "data type rather than DNN_FLOAT");
+        avpriv_report_missing_feature(filter_ctx, "data type rather than DNN_FLOAT");
         return DNN_ERROR;
     }
 
-    switch (frame->format) {
-        case AV_PIX_FMT_RGB24:
-            sws_ctx = sws_getContext(frame->width * 3,
-                                     frame->height,
-                                     AV_PIX_FMT_GRAY8,
-                                     frame->width * 3,
-                                     frame->height,
-                                     AV_PIX_FMT_GRAYF32,
-                                     0, NULL, NULL, NULL);
-            if (!sws_ctx) {
-                av_log(log_ctx, AV_LOG_ERROR, "Impossible to create scale context for the conversion "
-                                              "fmt:%s s:%dx%d -> fmt:%s s:%dx%d\n",
-                       av_get_pix_fmt_name(AV_PIX_FMT_GRAY8), frame->width * 3, frame->height,
-                       av_get_pix_fmt_name(AV_PIX_FMT_GRAYF32), frame->width * 3, frame->height);
-                return DNN_ERROR;
-            }
-            sws_scale(sws_ctx, (const uint8_t **) frame->data,
-                      frame->linesize, 0, frame->height,
-                      (uint8_t *const *) (&input->data),
-                      (const int[4]) {frame->width * 3 * sizeof(float), 0, 0, 0});
-            sws_freeContext(sws_ctx);
-            break;
-        default:
-            av_log(log_ctx, AV_LOG_ERROR, "Unsupported input pixel format for DNN, only RGB24 is supported\n");
-            return DNN_ERROR;
+    if (frame->format != AV_PIX_FMT_RGB24) {
+        av_log(filter_ctx, AV_LOG_ERROR, "Unsupported input pixel format for DNN, only RGB24 is supported\n");
+        return DNN_ERROR;
+    }
+
+    // Normalize the scaled RGB24 image straight into the input tensor. This
+    // cannot be folded into the sws_scale() call in queue_frame(): swscale
+    // only outputs planar floats (GBRPF32) while the model takes packed RGB,
+    // and the backend only hands out the tensor once the batch is filled.
+    for (int y = 0; y < frame->height; y++) {
+        for (int x = 0; x < len; x++)
+            dst[x] = src[x] * (1.0f / 255.0f);
+        src += frame->linesize[0];
+        dst += len;
     }
 
     return DNN_SUCCESS;
 }
 
 
+static av_cold int ringlog_open(AVFilterContext *context, int nb_scores)
+{
+#if HAVE_MMAP
+    LivepeerContext *ctx = context->priv;
+    RingLogHeader *header;
+    size_t entry_size = FFALIGN(sizeof(RingLogEntry) + nb_scores * sizeof(float), 8);
+    void *map;
+    int fd;
+
+    if (entry_size > UINT32_MAX ||
+        ctx->ringlog_entries > (SIZE_MAX - sizeof(*header)) / entry_size)
+        return AVERROR(EINVAL);
+    ctx->ringlog_size = sizeof(*header) + ctx->ringlog_entries * entry_size;
+
+    fd = avpriv_open(ctx->ringlog_filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return AVERROR(errno);
+    if (ftruncate(fd, ctx->ringlog_size) < 0) {
+        int err = AVERROR(errno);
+        close(fd);
+        return err;
+    }
+    map = mmap(NULL, ctx->ringlog_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+
+    // the file was truncated, so all records start out zeroed and invalid
+    header = map;
+    header->version    = RINGLOG_VERSION;
+    header->entry_size = entry_size;
+    header->nb_entries = ctx->ringlog_entries;
+    header->nb_scores  = nb_scores;
+    atomic_init(&header->head, 0);
+    // readers check the magic last
+    atomic_thread_fence(memory_order_release);
+    header->magic      = RINGLOG_MAGIC;
+
+    ctx->ringlog = header;
+    return 0;
+#else
+    avpriv_report_missing_feature(context, "ring log without mmap()");
+    return AVERROR(ENOSYS);
+#endif
+}
+
 static av_cold int init(AVFilterContext *context)
 {
     LivepeerContext *ctx = context->priv;
@@ -159,6 +317,26 @@ static av_cold int init(AVFilterContext *context)
         ctx->logfile = NULL;
         av_log(ctx, AV_LOG_INFO, "output file for log is not specified\n");
     }
+
+    if (ctx->batch_size > 1 && ctx->dnnctx.backend_type != DNN_TF) {
+        av_log(ctx, AV_LOG_ERROR, "batch_size > 1 is only supported by the tensorflow backend\n");
+        return AVERROR(EINVAL);
+    }
+    if (ctx->batch_size > 1) {
+        const char *opts = ctx->dnnctx.backend_options;
+        char *batch_opts = av_asprintf("%s%sbatch_size=%d", opts ? opts : "",
+                                       opts && *opts ? "&" : "", ctx->batch_size);
+        if (!batch_opts)
+            return AVERROR(ENOMEM);
+        av_free(ctx->dnnctx.backend_options);
+        ctx->dnnctx.backend_options = batch_opts;
+    }
+
+    ctx->pending = av_fifo_alloc2(ctx->batch_size, sizeof(LivepeerPendingFrame), AV_FIFO_FLAG_AUTO_GROW);
+    if (!ctx->pending)
+        return AVERROR(ENOMEM);
+    ctx->last_sample_time = AV_NOPTS_VALUE;
+
     ret = ff_dnn_init(&ctx->dnnctx, DFT_PROCESS_FRAME, context);
     if (ret != 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to initialize DNN backend\n");
@@ -178,6 +356,20 @@ static av_cold int init(AVFilterContext *context)
         return AVERROR(EIO);
     }
 
+    if (!ctx->model_id) {
+        ctx->model_id = av_strdup(av_basename(ctx->dnnctx.model_filename));
+        if (!ctx->model_id)
+            return AVERROR(ENOMEM);
+    }
+
+    if (ctx->ringlog_filename) {
+        ret = ringlog_open(context, ctx->output_height);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "could not create ring log %s\n", ctx->ringlog_filename);
+            return ret;
+        }
+    }
+
     ff_dnn_set_frame_proc(&ctx->dnnctx, pre_proc, post_proc);
 
     return ret;
@@ -200,102 +392,327 @@ static int query_formats(AVFilterContext *context)
     return ff_set_common_formats(context, formats_list);
 }
 
-static int prepare_sws_context(AVFilterLink *inlink)
+static int prepare_sws_context(AVFilterContext *context, int width, int height, enum AVPixelFormat fmt)
 {
-    int result = 0;
-    enum AVPixelFormat fmt = inlink->format;
-    AVFilterContext *context = inlink->dst;
     LivepeerContext *ctx = context->priv;
-    DNNData input;
-
-    ctx->dnnctx.model->get_input(ctx->dnnctx.model->model, &input, ctx->dnnctx.model_inputname);
-
-    ctx->sws_rgb_scale = sws_getContext(inlink->w, inlink->h, fmt,
-                                        input.width, input.height, AV_PIX_FMT_RGB24,
-                                        SWS_BILINEAR, NULL, NULL, NULL);
 
-    if (ctx->sws_rgb_scale == 0) {
+    ctx->sws_rgb_scale = sws_getCachedContext(ctx->sws_rgb_scale, width, height, fmt,
+                                              ctx->input_width, ctx->input_height, AV_PIX_FMT_RGB24,
+                                              SWS_BILINEAR, NULL, NULL, NULL);
+    if (!ctx->sws_rgb_scale) {
         av_log(ctx, AV_LOG_ERROR, "could not create scale context\n");
         return AVERROR(ENOMEM);
     }
 
-    ctx->swscaleframe = av_frame_alloc();
-    if (!ctx->swscaleframe)
-        return AVERROR(ENOMEM);
-
-    ctx->swscaleframe->format = AV_PIX_FMT_RGB24;
-    ctx->swscaleframe->width = input.width;
-    ctx->swscaleframe->height = input.height;
-
-    result = av_frame_get_buffer(ctx->swscaleframe, 0);
-    if (result < 0) {
-        av_frame_free(&ctx->swscaleframe);
-        return result;
-    }
+    ctx->sws_src_width  = width;
+    ctx->sws_src_height = height;
+    ctx->sws_src_format = fmt;
     return 0;
 }
 
+static AVFrame *alloc_scaled_frame(LivepeerContext *ctx)
+{
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+
+    frame->format = AV_PIX_FMT_RGB24;
+    frame->width = ctx->input_width;
+    frame->height = ctx->input_height;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *context = inlink->dst;
     LivepeerContext *ctx = context->priv;
-    int check;
-    check = prepare_sws_context(inlink);
-    if (check != 0) {
+    int ret;
+
+    ret = prepare_sws_context(context, inlink->w, inlink->h, inlink->format);
+    if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "could not create scale context for the model\n");
         return AVERROR(EIO);
     }
+
+    if (!ctx->free_scaled) {
+        ctx->free_scaled = av_fifo_alloc2(ctx->batch_size, sizeof(AVFrame *), AV_FIFO_FLAG_AUTO_GROW);
+        if (!ctx->free_scaled)
+            return AVERROR(ENOMEM);
+
+        for (int i = 0; i < ctx->batch_size; i++) {
+            AVFrame *scaled = alloc_scaled_frame(ctx);
+            if (!scaled)
+                return AVERROR(ENOMEM);
+            av_fifo_write(ctx->free_scaled, &scaled, 1);
+        }
+    }
     return 0;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+static int is_sampled(AVFilterLink *inlink, const AVFrame *in)
+{
+    LivepeerContext *ctx = inlink->dst->priv;
+    int64_t n = ctx->nb_frames++;
+
+    if (ctx->time_interval && in->pts != AV_NOPTS_VALUE) {
+        int64_t t = av_rescale_q(in->pts, inlink->time_base, AV_TIME_BASE_Q);
+
+        // a timestamp jump backwards restarts the sampling clock
+        if (ctx->last_sample_time != AV_NOPTS_VALUE && t >= ctx->last_sample_time &&
+            t - ctx->last_sample_time < ctx->time_interval)
+            return 0;
+        ctx->last_sample_time = t;
+        return 1;
+    }
+
+    return n % ctx->interval == 0;
+}
+
+static void copy_result(AVDictionary **dst, const AVDictionary *src)
+{
+    const AVDictionaryEntry *e = NULL;
+
+    while ((e = av_dict_get(src, "lavfi.lvpdnn.", e, AV_DICT_IGNORE_SUFFIX)))
+        av_dict_set(dst, e->key, e->value, 0);
+}
+
+static int output_frame(AVFilterContext *context, AVFrame *frame, int sampled)
+{
+    LivepeerContext *ctx = context->priv;
+
+    if (sampled) {
+        AVFrameSideData *sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CLASSIFICATION_SCORES);
+
+        av_dict_free(&ctx->last_result);
+        copy_result(&ctx->last_result, frame->metadata);
+        av_buffer_unref(&ctx->last_scores);
+        if (sd) {
+            ctx->last_scores = av_buffer_ref(sd->buf);
+            if (!ctx->last_scores) {
+                av_frame_free(&frame);
+                return AVERROR(ENOMEM);
+            }
+        }
+    } else {
+        copy_result(&frame->metadata, ctx->last_result);
+        if (ctx->last_scores) {
+            AVBufferRef *ref = av_buffer_ref(ctx->last_scores);
+            if (!ref || !av_frame_new_side_data_from_buf(frame, AV_FRAME_DATA_CLASSIFICATION_SCORES, ref)) {
+                av_buffer_unref(&ref);
+                av_frame_free(&frame);
+                return AVERROR(ENOMEM);
+            }
+        }
+    }
+
+    return ff_filter_frame(context->outputs[0], frame);
+}
+
+/**
+ * Send out every held back frame whose classification is done, in input
+ * order. Returns the number of frames sent or a negative error code.
+ */
+static int release_frames(AVFilterContext *context)
+{
+    LivepeerContext *ctx = context->priv;
+    LivepeerPendingFrame p;
+    int nb_out = 0, ret;
+
+    while (av_fifo_peek(ctx->pending, &p, 1, 0) >= 0) {
+        if (p.sampled) {
+            if (!ctx->nb_done)
+                break;
+            ctx->nb_done--;
+        }
+        av_fifo_drain2(ctx->pending, 1);
+
+        ret = output_frame(context, p.frame, p.sampled);
+        if (ret < 0)
+            return ret;
+        nb_out++;
+    }
+    return nb_out;
+}
+
+/**
+ * Collect the classifications that came back from the backend without
+ * waiting for the ones still in flight.
+ */
+static int collect_results(AVFilterContext *context)
+{
+    LivepeerContext *ctx = context->priv;
+
+    while (ctx->nb_inflight > 0) {
+        AVFrame *in_frame = NULL, *out_frame = NULL;
+        DNNAsyncStatusType async_state = ff_dnn_get_result(&ctx->dnnctx, &in_frame, &out_frame);
+
+        if (async_state == DAST_NOT_READY)
+            break;
+        if (async_state != DAST_SUCCESS) {
+            av_log(context, AV_LOG_ERROR, "lost %d frames in flight\n", ctx->nb_inflight);
+            return AVERROR(EIO);
+        }
+
+        // results come back in submission order, so this is the oldest sampled frame
+        ctx->nb_inflight--;
+        ctx->nb_done++;
+        av_fifo_write(ctx->free_scaled, &in_frame, 1);
+    }
+    return 0;
+}
+
+/**
+ * Classify or hold back one input frame. Returns the number of frames
+ * sent or a negative error code.
+ */
+static int queue_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *context = inlink->dst;
     LivepeerContext *ctx = context->priv;
-    AVFilterLink *outlink = context->outputs[0];
-    DNNReturnType dnn_result;
+    LivepeerPendingFrame p = { .frame = in, .sampled = is_sampled(inlink, in) };
+    AVFrame *scaled;
+    int ret;
+
+    if (!p.sampled) {
+        // only frames behind a pending classification have to wait for it
+        if (!av_fifo_can_read(ctx->pending)) {
+            ret = output_frame(context, in, 0);
+            return ret < 0 ? ret : 1;
+        }
+        ret = av_fifo_write(ctx->pending, &p, 1);
+        if (ret < 0)
+            av_frame_free(&in);
+        return ret;
+    }
 
-    AVFrame *out = ff_get_video_buffer(outlink, 64, 64);
-    if (!out) {
-        av_log(context, AV_LOG_ERROR, "could not allocate memory for output frame\n");
-        av_frame_free(&in);
-        return AVERROR(ENOMEM);
+    // The scale context only depends on the input geometry, rebuild it on change.
+    if (in->width != ctx->sws_src_width || in->height != ctx->sws_src_height ||
+        in->format != ctx->sws_src_format) {
+        ret = prepare_sws_context(context, in->width, in->height, in->format);
+        if (ret < 0) {
+            av_frame_free(&in);
+            return ret;
+        }
+    }
+
+    // more inferences in flight than preallocated images, grow the set
+    if (av_fifo_read(ctx->free_scaled, &scaled, 1) < 0) {
+        scaled = alloc_scaled_frame(ctx);
+        if (!scaled) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
     }
-    av_frame_copy_props(out, in);
 
     // Scale frame and transform pixel format to what DNN expects.
     sws_scale(ctx->sws_rgb_scale, (const uint8_t **) in->data, in->linesize,
-              0, in->height, (uint8_t *const *) (&ctx->swscaleframe->data),
-              ctx->swscaleframe->linesize);
-
-    // Execute model.
-    dnn_result = ff_dnn_execute_model(&ctx->dnnctx, ctx->swscaleframe, out);
+              0, in->height, (uint8_t *const *) (&scaled->data), scaled->linesize);
 
-    // Copy classification metadata to input frame (check if we can use output frame)
-    av_dict_copy(&in->metadata, out->metadata, 0);
+    ret = av_fifo_write(ctx->pending, &p, 1);
+    if (ret < 0) {
+        av_frame_free(&scaled);
+        av_frame_free(&in);
+        return ret;
+    }
 
-    if (dnn_result != DNN_SUCCESS) {
+    // The classification is written straight into the metadata of the input frame.
+    if (ff_dnn_execute_model(&ctx->dnnctx, scaled, in) != DNN_SUCCESS) {
         av_log(ctx, AV_LOG_ERROR, "failed to execute loaded model\n");
-        av_frame_free(&in);
-        av_frame_free(&out);
+        av_frame_free(&scaled);
         return AVERROR(EIO);
     }
+    ctx->nb_inflight++;
 
-    // Don't use model output directly
-    av_frame_free(&out);
-    return ff_filter_frame(outlink, in);
+    return 0;
+}
+
+static int activate(AVFilterContext *context)
+{
+    AVFilterLink *inlink = context->inputs[0];
+    AVFilterLink *outlink = context->outputs[0];
+    LivepeerContext *ctx = context->priv;
+    AVFrame *in;
+    int64_t pts;
+    int ret, status;
+    int got_frame = 0;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    while ((ret = ff_inlink_consume_frame(inlink, &in)) > 0) {
+        ret = queue_frame(inlink, in);
+        if (ret < 0)
+            return ret;
+        got_frame |= ret > 0;
+    }
+    if (ret < 0)
+        return ret;
+
+    // inference runs in the background, only pick up what is already done,
+    // results still in flight are collected on the next input frame
+    ret = collect_results(context);
+    if (ret < 0)
+        return ret;
+    ret = release_frames(context);
+    if (ret < 0)
+        return ret;
+    got_frame |= ret > 0;
+
+    if (got_frame)
+        return 0;
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        if (status == AVERROR_EOF) {
+            // run the partial batch and wait for everything in flight
+            if (ff_dnn_flush(&ctx->dnnctx) != 0)
+                return AVERROR(EIO);
+            while (ctx->nb_inflight > 0) {
+                av_usleep(5000);
+                ret = collect_results(context);
+                if (ret < 0)
+                    return ret;
+            }
+            ret = release_frames(context);
+            if (ret < 0)
+                return ret;
+        }
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
 }
 
 static av_cold void uninit(AVFilterContext *context)
 {
     LivepeerContext *ctx = context->priv;
+    LivepeerPendingFrame p;
 
     sws_freeContext(ctx->sws_rgb_scale);
 
-    if (ctx->swscaleframe)
-        av_frame_free(&ctx->swscaleframe);
-
     ff_dnn_uninit(&ctx->dnnctx);
+
+    if (ctx->free_scaled) {
+        AVFrame *scaled;
+        while (av_fifo_read(ctx->free_scaled, &scaled, 1) >= 0)
+            av_frame_free(&scaled);
+        av_fifo_freep2(&ctx->free_scaled);
+    }
+    if (ctx->pending) {
+        while (av_fifo_read(ctx->pending, &p, 1) >= 0)
+            av_frame_free(&p.frame);
+        av_fifo_freep2(&ctx->pending);
+    }
+    av_dict_free(&ctx->last_result);
+    av_buffer_unref(&ctx->last_scores);
+#if HAVE_MMAP
+    if (ctx->ringlog)
+        munmap(ctx->ringlog, ctx->ringlog_size);
+#endif
+
     if (ctx->log_filename && ctx->logfile) {
         fclose(ctx->logfile);
     }
@@ -306,9 +723,7 @@ static const AVFilterPad livepeer_inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .config_props = config_input,
-        .filter_frame = filter_frame,
     },
-    {NULL}
 };
 
 static const AVFilterPad livepeer_outputs[] = {
@@ -316,17 +731,17 @@ static const AVFilterPad livepeer_outputs[] = {
         .name = "default",
         .type = AVMEDIA_TYPE_VIDEO,
     },
-    {NULL}
 };
 
-AVFilter ff_vf_livepeer_dnn = {
+const AVFilter ff_vf_livepeer_dnn = {
     .name          = "livepeer_dnn",
     .description   = NULL_IF_CONFIG_SMALL("Perform DNN-based scene classification on input."),
     .priv_size     = sizeof(LivepeerContext),
     .init          = init,
     .uninit        = uninit,
+    .activate      = activate,
     FILTER_QUERY_FUNC(query_formats),
-    .inputs        = livepeer_inputs,
-    .outputs       = livepeer_outputs,
+    FILTER_INPUTS(livepeer_inputs),
+    FILTER_OUTPUTS(livepeer_outputs),
     .priv_class    = &livepeer_class,
 };
@@ -0,0 +1,447 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale one video input to several output sizes at once
+ *
+ * The outputs (rungs of the ladder) are scaled together by an SwsLadder, which
+ * scales every rung from the smallest other rung that is at least as large, so
+ * the source frame is read only by the largest rungs. Rungs of the same size as
+ * the input or as another rung share its buffers.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "scale_eval.h"
+#include "video.h"
+
+typedef struct Rung {
+    // requested size, may be negative to keep the input aspect ratio
+    int w_req, h_req;
+    int w, h;
+
+    // output a reference to the input or to an earlier rung of the same size
+    // instead of scaling
+    int same_as_input;
+    int same_as;
+} Rung;
+
+typedef struct ScaleLadderContext {
+    const AVClass *class;
+
+    char *sizes_str;
+    char *flags_str;
+    int   cascade;
+    int   threads;
+
+    Rung *rungs;
+    int   nb_rungs;
+
+    SwsLadder *ladder;
+    int        ladder_range;
+
+    // input size the copies were determined for
+    int in_w, in_h;
+
+    AVFrame **frames;
+    // frames passed to the ladder
+    AVFrame **scaled;
+} ScaleLadderContext;
+
+static int query_formats(AVFilterContext *ctx)
+{
+    const AVPixFmtDescriptor *desc = NULL;
+    AVFilterFormats *formats = NULL;
+    int ret;
+
+    // all rungs are scaled from each other, so they all use the input format
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+
+        if (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))
+            continue;
+        if (sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+
+    return ff_set_common_formats(ctx, formats);
+}
+
+static int ladder_alloc(AVFilterContext *ctx, enum AVColorRange range)
+{
+    ScaleLadderContext *s = ctx->priv;
+    struct SwsContext *opts;
+    int ret = 0;
+
+    sws_ladder_free(&s->ladder);
+
+    opts = sws_alloc_context();
+    if (!opts)
+        return AVERROR(ENOMEM);
+
+    // scaling only, keep the range as is
+    if (range == AVCOL_RANGE_JPEG) {
+        ret = av_opt_set_int(opts, "src_range", 1, 0);
+        if (ret >= 0)
+            ret = av_opt_set_int(opts, "dst_range", 1, 0);
+    }
+    if (ret >= 0 && s->flags_str && *s->flags_str)
+        ret = av_opt_set(opts, "sws_flags", s->flags_str, 0);
+
+    // threaded scalers are run on whole frames, only single threaded ones
+    // in the band pipeline of the ladder
+    if (ret >= 0)
+        ret = av_opt_set_int(opts, "threads",
+                             s->threads ? s->threads : ff_filter_get_nb_threads(ctx), 0);
+    if (ret >= 0) {
+        s->ladder = sws_ladder_alloc(opts, s->cascade ? 0 : SWS_LADDER_NO_CASCADE);
+        if (!s->ladder)
+            ret = AVERROR(ENOMEM);
+    }
+    s->ladder_range = range;
+
+    sws_freeContext(opts);
+    return ret;
+}
+
+static void find_copies(AVFilterContext *ctx, int w, int h)
+{
+    ScaleLadderContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_rungs; i++) {
+        Rung *r = &s->rungs[i];
+
+        r->same_as_input = r->w == w && r->h == h;
+        r->same_as       = -1;
+
+        for (int j = 0; j < i && !r->same_as_input; j++) {
+            if (s->rungs[j].w == r->w && s->rungs[j].h == r->h) {
+                r->same_as = j;
+                break;
+            }
+        }
+    }
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleLadderContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_rungs; i++) {
+        Rung *r = &s->rungs[i];
+
+        r->w = r->w_req;
+        r->h = r->h_req;
+        ff_scale_adjust_dimensions(inlink, &r->w, &r->h, 0, 1);
+
+        if (r->w <= 0 || r->h <= 0 || r->w > INT_MAX / 2 || r->h > INT_MAX / 2) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size %dx%d for output%d\n",
+                   r->w, r->h, i);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    find_copies(ctx, inlink->w, inlink->h);
+    s->in_w = inlink->w;
+    s->in_h = inlink->h;
+
+    return ladder_alloc(ctx, inlink->color_range);
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    ScaleLadderContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const Rung *r = &s->rungs[FF_OUTLINK_IDX(outlink)];
+
+    outlink->w = r->w;
+    outlink->h = r->h;
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+    const char *p = s->sizes_str;
+    int ret;
+
+    if (!p || !*p) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    while (*p) {
+        char *size = av_get_token(&p, "|");
+        Rung *r;
+
+        if (!size)
+            return AVERROR(ENOMEM);
+
+        r = av_dynarray2_add((void **)&s->rungs, &s->nb_rungs, sizeof(*r), NULL);
+        if (!r) {
+            av_free(size);
+            return AVERROR(ENOMEM);
+        }
+        memset(r, 0, sizeof(*r));
+
+        if (sscanf(size, "%dx%d", &r->w_req, &r->h_req) != 2 &&
+            av_parse_video_size(&r->w_req, &r->h_req, size) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid output size '%s'\n", size);
+            av_free(size);
+            return AVERROR(EINVAL);
+        }
+        if (!r->w_req || !r->h_req || (r->w_req < 0 && r->h_req < 0)) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid output size '%s'\n", size);
+            av_free(size);
+            return AVERROR(EINVAL);
+        }
+        av_free(size);
+
+        if (*p)
+            p++;
+    }
+
+    s->frames = av_calloc(s->nb_rungs, sizeof(*s->frames));
+    s->scaled = av_calloc(s->nb_rungs, sizeof(*s->scaled));
+    if (!s->frames || !s->scaled)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < s->nb_rungs; i++) {
+        AVFilterPad pad = { 0 };
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", i);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        if ((ret = ff_append_outpad_free_name(ctx, &pad)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+
+    sws_ladder_free(&s->ladder);
+
+    if (s->frames) {
+        for (int i = 0; i < s->nb_rungs; i++)
+            av_frame_free(&s->frames[i]);
+    }
+    av_freep(&s->rungs);
+    s->nb_rungs = 0;
+
+    av_freep(&s->frames);
+    av_freep(&s->scaled);
+}
+
+static int filter_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    ScaleLadderContext *s = ctx->priv;
+    int nb_scaled = 0, ret = 0;
+
+    if (in->width != s->in_w || in->height != s->in_h) {
+        find_copies(ctx, in->width, in->height);
+        s->in_w = in->width;
+        s->in_h = in->height;
+    }
+    if (in->color_range != s->ladder_range) {
+        ret = ladder_alloc(ctx, in->color_range);
+        if (ret < 0)
+            goto finish;
+    }
+
+    // scale the rungs that are open or have an open copy
+    for (int i = 0; i < s->nb_rungs; i++) {
+        const Rung *r = &s->rungs[i];
+        int needed = !ff_outlink_get_status(ctx->outputs[i]);
+        AVFrame *out;
+
+        if (r->same_as_input || r->same_as >= 0)
+            continue;
+
+        for (int j = i + 1; j < s->nb_rungs && !needed; j++)
+            needed = s->rungs[j].same_as == i && !ff_outlink_get_status(ctx->outputs[j]);
+        if (!needed)
+            continue;
+
+        out = ff_get_video_buffer(ctx->outputs[i], r->w, r->h);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+        s->frames[i] = out;
+
+        ret = av_frame_copy_props(out, in);
+        if (ret < 0)
+            goto finish;
+        out->width  = r->w;
+        out->height = r->h;
+
+        av_reduce(&out->sample_aspect_ratio.num, &out->sample_aspect_ratio.den,
+                  (int64_t)in->sample_aspect_ratio.num * r->h * in->width,
+                  (int64_t)in->sample_aspect_ratio.den * r->w * in->height,
+                  INT_MAX);
+
+        s->scaled[nb_scaled++] = out;
+    }
+
+    if (nb_scaled) {
+        ret = sws_ladder_scale(s->ladder, s->scaled, nb_scaled, in);
+        if (ret < 0)
+            goto finish;
+    }
+
+    // copies only ever refer to scaled rungs, which are all done now
+    for (int i = 0; i < s->nb_rungs; i++) {
+        const Rung *r = &s->rungs[i];
+
+        if (s->frames[i] || ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        s->frames[i] = av_frame_clone(r->same_as_input ? in : s->frames[r->same_as]);
+        if (!s->frames[i]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+    }
+
+    for (int i = 0; i < s->nb_rungs; i++) {
+        AVFrame *out = s->frames[i];
+
+        if (!out || ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        s->frames[i] = NULL;
+        ret = ff_filter_frame(ctx->outputs[i], out);
+        if (ret < 0)
+            goto finish;
+    }
+
+finish:
+    for (int i = 0; i < s->nb_rungs; i++)
+        av_frame_free(&s->frames[i]);
+    av_frame_free(&in);
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in;
+    int status, ret, nb_eofs = 0;
+    int64_t pts;
+
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        nb_eofs += ff_outlink_get_status(ctx->outputs[i]) == AVERROR_EOF;
+
+    if (nb_eofs == ctx->nb_outputs) {
+        ff_inlink_set_status(inlink, AVERROR_EOF);
+        return 0;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0)
+        return filter_frame(ctx, in);
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        for (int i = 0; i < ctx->nb_outputs; i++) {
+            if (ff_outlink_get_status(ctx->outputs[i]))
+                continue;
+            ff_outlink_set_status(ctx->outputs[i], status, pts);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        if (ff_outlink_frame_wanted(ctx->outputs[i])) {
+            ff_inlink_request_frame(inlink);
+            return 0;
+        }
+    }
+
+    return FFERROR_NOT_READY;
+}
+
+#define OFFSET(x) offsetof(ScaleLadderContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scaleladder_options[] = {
+    { "sizes",   "'|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL }, .flags = FLAGS },
+    { "flags",   "Flags to pass to libswscale",         OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "" },   .flags = FLAGS },
+    { "cascade", "scale outputs from larger outputs instead of the input", OFFSET(cascade), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { "threads", "threads of each scaler, 0 for the filter threads", OFFSET(threads), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, INT_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scaleladder);
+
+static const AVFilterPad scaleladder_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+    },
+};
+
+const AVFilter ff_vf_scaleladder = {
+    .name          = "scaleladder",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes, each from the next larger one."),
+    .priv_size     = sizeof(ScaleLadderContext),
+    .priv_class    = &scaleladder_class,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    FILTER_INPUTS(scaleladder_inputs),
+    .outputs       = NULL,
+    FILTER_QUERY_FUNC(query_formats),
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
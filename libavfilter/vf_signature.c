@@ -25,11 +25,12 @@
  */
 
 #include "libavcodec/put_bits.h"
-#include "libavcodec/get_bits.h"
 #include "libavformat/avformat.h"
 #include "libavutil/opt.h"
 #include "libavutil/avstring.h"
 #include "libavutil/file_open.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/slicethread.h"
 #include "avfilter.h"
 #include "internal.h"
 #include "signature.h"
@@ -41,6 +42,12 @@
 #define INPUTS_COUNT 2
 #define MPEG7_FINESIG_NBITS 689
 
+typedef struct ThreadData {
+    const AVFrame *in;
+    StreamContext *sc;
+    uint64_t (*intpic)[32];
+} ThreadData;
+
 typedef struct BoundedCoarseSignature {
     // StartFrameOfSegment and EndFrameOfSegment
     uint32_t firstIndex, lastIndex;
@@ -73,6 +80,8 @@ static const AVOption signature_options[] = {
         OFFSET(thdi),         AV_OPT_TYPE_INT,    {.i64 = 0},        0, INT_MAX,          FLAGS },
     { "th_it",      "threshold for relation of good to all frames",
         OFFSET(thit),         AV_OPT_TYPE_DOUBLE, {.dbl = 0.5},    0.0, 1.0,              FLAGS },
+    { "segment_frames", "export the signature in segments of that many frames",
+        OFFSET(segment_frames), AV_OPT_TYPE_INT,  {.i64 = 0},        0, INT_MAX,          FLAGS },
     { NULL }
 };
 
@@ -96,6 +105,9 @@ static int config_input(AVFilterLink *inlink)
     AVFilterContext *ctx = inlink->dst;
     SignatureContext *sic = ctx->priv;
     StreamContext *sc = &(sic->streamcontexts[FF_INLINK_IDX(inlink)]);
+    int32_t dh1 = 1, dh2 = 1, dw1 = 1, dw2 = 1;
+    int nb_jobs = FFMIN(32, ff_filter_get_nb_threads(ctx));
+    int i, a, b;
 
     sc->time_base = inlink->time_base;
     /* test for overflow */
@@ -105,30 +117,116 @@ static int config_input(AVFilterLink *inlink)
     }
     sc->w = inlink->w;
     sc->h = inlink->h;
+
+    /* pixel (i, j) belongs to block ((i*32)/h, (j*32)/w) */
+    for (i = 0; i <= 32; i++) {
+        sc->rowstart[i] = (i * inlink->h + 31) / 32;
+        sc->colstart[i] = (i * inlink->w + 31) / 32;
+    }
+
+    /* The blocks are brought to the same denominator later on, which needs
+     * the two possible block heights and widths and the weight of each block.
+     */
+    dh1 = inlink->h / 32;
+    if (inlink->h % 32)
+        dh2 = dh1 + 1;
+    dw1 = inlink->w / 32;
+    if (inlink->w % 32)
+        dw2 = dw1 + 1;
+    sc->blocksize = dh1 * (int64_t)dh2 * dw1 * dw2;
+
+    for (i = 0; i < 32; i++) {
+        a = 1;
+        if (dh2 > 1) {
+            a = ((inlink->h*(i+1))%32 == 0) ? (inlink->h*(i+1))/32 - 1 : (inlink->h*(i+1))/32;
+            a -= ((inlink->h*i)%32 == 0) ? (inlink->h*i)/32 - 1 : (inlink->h*i)/32;
+            a = (a == dh1)? dh2 : dh1;
+        }
+        sc->rowweight[i] = a;
+
+        b = 1;
+        if (dw2 > 1) {
+            b = ((inlink->w*(i+1))%32 == 0) ? (inlink->w*(i+1))/32 - 1 : (inlink->w*(i+1))/32;
+            b -= ((inlink->w*i)%32 == 0) ? (inlink->w*i)/32 - 1 : (inlink->w*i)/32;
+            b = (b == dw1)? dw2 : dw1;
+        }
+        sc->colweight[i] = b;
+    }
+
+    sc->colsums_stride = FFALIGN(inlink->w, 32);
+    av_freep(&sc->colsums);
+    sc->colsums = av_malloc_array(nb_jobs, sc->colsums_stride * sizeof(*sc->colsums));
+    if (!sc->colsums)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static void sum_columns(const StreamContext *sc, const uint16_t *colsums, uint64_t *intpicrow)
+{
+    for (int j = 0; j < 32; j++) {
+        uint64_t sum = 0;
+        for (int x = sc->colstart[j]; x < sc->colstart[j+1]; x++)
+            sum += colsums[x];
+        intpicrow[j] += sum;
+    }
+}
+
+/* sum up the pixels of each block, every job handles a range of block rows */
+static int sum_blocks(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    const StreamContext *sc = td->sc;
+    const AVFrame *in = td->in;
+    const int w = sc->w;
+    const int start = (32 * jobnr) / nb_jobs;
+    const int end = (32 * (jobnr+1)) / nb_jobs;
+    uint16_t *colsums = sc->colsums + jobnr * sc->colsums_stride;
+
+    for (int i = start; i < end; i++) {
+        const uint8_t *p = in->data[0] + sc->rowstart[i] * (ptrdiff_t)in->linesize[0];
+        int nb_rows = 0;
+
+        memset(td->intpic[i], 0, sizeof(td->intpic[i]));
+        memset(colsums, 0, w * sizeof(*colsums));
+        for (int y = sc->rowstart[i]; y < sc->rowstart[i+1]; y++) {
+            for (int x = 0; x < w; x++)
+                colsums[x] += p[x];
+            p += in->linesize[0];
+
+            /* 257 rows of 255 still fit into 16 bits */
+            if (++nb_rows == 257) {
+                sum_columns(sc, colsums, td->intpic[i]);
+                memset(colsums, 0, w * sizeof(*colsums));
+                nb_rows = 0;
+            }
+        }
+        if (nb_rows)
+            sum_columns(sc, colsums, td->intpic[i]);
+    }
     return 0;
 }
 
+static int export_segment(AVFilterContext *ctx, StreamContext *sc);
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 {
     AVFilterContext *ctx = inlink->dst;
     SignatureContext *sic = ctx->priv;
     StreamContext *sc = &(sic->streamcontexts[FF_INLINK_IDX(inlink)]);
     FineSignature* fs;
+    ThreadData td;
 
     uint64_t intpic[32][32];
     uint64_t rowcount;
-    uint8_t *p = picref->data[0];
-    int inti, intj;
-    int *intjlut;
     int i, j, ret;
-    int32_t dh1 = 1, dh2 = 1, dw1 = 1, dw2 = 1, a, b;
     int64_t denom;
 
     int64_t precfactor = (sc->divide) ? 65536 : BLOCK_LCM;
 
     /* initialize fs */
     if (sc->curfinesig) {
-        fs = av_mallocz(sizeof(FineSignature));
+        fs = alloc_finesignature(sc);
         if (!fs)
             return AVERROR(ENOMEM);
         sc->curfinesig->next = fs;
@@ -142,52 +240,22 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     fs->pts = picref->pts;
     fs->index = sc->lastindex++;
 
-    memset(intpic, 0, sizeof(uint64_t)*32*32);
-    intjlut = av_malloc_array(inlink->w, sizeof(int));
-    if (!intjlut)
-        return AVERROR(ENOMEM);
-    for (i = 0; i < inlink->w; i++) {
-        intjlut[i] = (i*32)/inlink->w;
-    }
-
-    for (i = 0; i < inlink->h; i++) {
-        inti = (i*32)/inlink->h;
-        for (j = 0; j < inlink->w; j++) {
-            intj = intjlut[j];
-            intpic[inti][intj] += p[j];
-        }
-        p += picref->linesize[0];
-    }
-    av_freep(&intjlut);
+    td.in = picref;
+    td.sc = sc;
+    td.intpic = intpic;
+    ff_filter_execute(ctx, sum_blocks, &td, NULL,
+                      FFMIN(32, ff_filter_get_nb_threads(ctx)));
 
     /* The following calculates a summed area table (intpic) and brings the numbers
      * in intpic to the same denominator.
      * So you only have to handle the numinator in the following sections.
      */
-    dh1 = inlink->h / 32;
-    if (inlink->h % 32)
-        dh2 = dh1 + 1;
-    dw1 = inlink->w / 32;
-    if (inlink->w % 32)
-        dw2 = dw1 + 1;
-    denom = (sc->divide) ? dh1 * (int64_t)dh2 * dw1 * dw2 : 1;
+    denom = (sc->divide) ? sc->blocksize : 1;
 
     for (i = 0; i < 32; i++) {
         rowcount = 0;
-        a = 1;
-        if (dh2 > 1) {
-            a = ((inlink->h*(i+1))%32 == 0) ? (inlink->h*(i+1))/32 - 1 : (inlink->h*(i+1))/32;
-            a -= ((inlink->h*i)%32 == 0) ? (inlink->h*i)/32 - 1 : (inlink->h*i)/32;
-            a = (a == dh1)? dh2 : dh1;
-        }
         for (j = 0; j < 32; j++) {
-            b = 1;
-            if (dw2 > 1) {
-                b = ((inlink->w*(j+1))%32 == 0) ? (inlink->w*(j+1))/32 - 1 : (inlink->w*(j+1))/32;
-                b -= ((inlink->w*j)%32 == 0) ? (inlink->w*j)/32 - 1 : (inlink->w*j)/32;
-                b = (b == dw1)? dw2 : dw1;
-            }
-            rowcount += intpic[i][j] * a * b * precfactor / denom;
+            rowcount += intpic[i][j] * sc->rowweight[i] * sc->colweight[j] * precfactor / denom;
             if (i > 0) {
                 intpic[i][j] = intpic[i-1][j] + rowcount;
             } else {
@@ -196,10 +264,16 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
         }
     }
 
-    denom = (sc->divide) ? 1 : dh1 * (int64_t)dh2 * dw1 * dw2;
+    denom = (sc->divide) ? 1 : sc->blocksize;
     ret = calc_signature(ctx, sc, fs, intpic, denom, precfactor);
     if (ret < 0) return ret;
 
+    if (sic->segment_frames && sc->lastindex == sic->segment_frames) {
+        ret = export_segment(ctx, sc);
+        if (ret < 0)
+            return ret;
+    }
+
     if (FF_INLINK_IDX(inlink) == 0)
         return ff_filter_frame(inlink->dst->outputs[0], picref);
     return 1;
@@ -397,6 +471,9 @@ static int export(AVFilterContext *ctx, StreamContext *sc, int input)
     if (sic->nb_inputs > 1) {
         /* error already handled */
         av_assert0(av_get_frame_filename(filename, sizeof(filename), sic->filename, input) == 0);
+    } else if (sic->segmented) {
+        /* checked when segmenting was enabled */
+        av_assert0(av_get_frame_filename(filename, sizeof(filename), sic->filename, sic->nb_segments) == 0);
     } else {
         if (av_strlcpy(filename, sic->filename, sizeof(filename)) >= sizeof(filename))
             return AVERROR(EINVAL);
@@ -408,6 +485,87 @@ static int export(AVFilterContext *ctx, StreamContext *sc, int input)
     }
 }
 
+/**
+ * start a new, empty signature, e.g. for the next segment
+ */
+static int start_signature(StreamContext *sc)
+{
+    sc->lastindex = 0;
+    sc->finesiglist = alloc_finesignature(sc);
+    if (!sc->finesiglist)
+        return AVERROR(ENOMEM);
+    sc->curfinesig = NULL;
+
+    sc->coarsesiglist = alloc_coarsesignature(sc);
+    if (!sc->coarsesiglist)
+        return AVERROR(ENOMEM);
+    sc->curcoarsesig1 = sc->coarsesiglist;
+    sc->coarseend = sc->coarsesiglist;
+    sc->coarsecount = 0;
+    sc->midcoarse = 0;
+
+    return 0;
+}
+
+/**
+ * export the signature of the frames since the last segment boundary as
+ * a complete signature of its own and drop it, so memory use stays bounded
+ */
+static int export_segment(AVFilterContext *ctx, StreamContext *sc)
+{
+    SignatureContext *sic = ctx->priv;
+    int ret;
+
+    if (!sc->lastindex)
+        return 0;
+
+    if (strlen(sic->filename) > 0) {
+        ret = export(ctx, sc, 0);
+        if (ret < 0)
+            return ret;
+    }
+    sic->nb_segments++;
+
+    free_signatures(sc);
+    ret = start_signature(sc);
+    if (ret < 0)
+        return ret;
+    av_log(ctx, AV_LOG_DEBUG, "Exported segment %d, %d fine and %d coarse signature chunks kept.\n",
+           sic->nb_segments - 1, sc->finearena.nb_chunks, sc->coarsearena.nb_chunks);
+    return 0;
+}
+
+static int can_segment(AVFilterContext *ctx)
+{
+    SignatureContext *sic = ctx->priv;
+    char tmp[1024];
+
+    if (sic->nb_inputs > 1 || sic->mode != MODE_OFF) {
+        av_log(ctx, AV_LOG_ERROR, "Segmented export needs a single input and detectmode off.\n");
+        return AVERROR(EINVAL);
+    }
+    if (strlen(sic->filename) > 0 && av_get_frame_filename(tmp, sizeof(tmp), sic->filename, 0) == -1) {
+        av_log(ctx, AV_LOG_ERROR, "The filename must contain %%d or %%0nd for segmented export.\n");
+        return AVERROR(EINVAL);
+    }
+    sic->segmented = 1;
+    return 0;
+}
+
+static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
+                           char *res, int res_len, int flags)
+{
+    SignatureContext *sic = ctx->priv;
+    int ret;
+
+    if (strcmp(cmd, "segment"))
+        return AVERROR(ENOSYS);
+
+    if ((ret = can_segment(ctx)) < 0)
+        return ret;
+    return export_segment(ctx, &sic->streamcontexts[0]);
+}
+
 static int request_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -429,8 +587,8 @@ static int request_frame(AVFilterLink *outlink)
 
         /* export signature at EOF */
         if (ret == AVERROR_EOF && !sc->exported) {
-            /* export if wanted */
-            if (strlen(sic->filename) > 0) {
+            /* export if wanted, a last segment may be empty */
+            if (strlen(sic->filename) > 0 && sc->lastindex) {
                 if (export(ctx, sc, i) < 0)
                     return ret;
             }
@@ -490,20 +648,8 @@ static av_cold int init(AVFilterContext *ctx)
             return ret;
 
         sc = &(sic->streamcontexts[i]);
-
-        sc->lastindex = 0;
-        sc->finesiglist = av_mallocz(sizeof(FineSignature));
-        if (!sc->finesiglist)
-            return AVERROR(ENOMEM);
-        sc->curfinesig = NULL;
-
-        sc->coarsesiglist = av_mallocz(sizeof(CoarseSignature));
-        if (!sc->coarsesiglist)
-            return AVERROR(ENOMEM);
-        sc->curcoarsesig1 = sc->coarsesiglist;
-        sc->coarseend = sc->coarsesiglist;
-        sc->coarsecount = 0;
-        sc->midcoarse = 0;
+        if ((ret = start_signature(sc)) < 0)
+            return ret;
     }
 
     /* check filename */
@@ -511,6 +657,8 @@ static av_cold int init(AVFilterContext *ctx)
         av_log(ctx, AV_LOG_ERROR, "The filename must contain %%d or %%0nd, if you have more than one input.\n");
         return AVERROR(EINVAL);
     }
+    if (sic->segment_frames && (ret = can_segment(ctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -519,32 +667,14 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     SignatureContext *sic = ctx->priv;
     StreamContext *sc;
-    void* tmp;
-    FineSignature* finsig;
-    CoarseSignature* cousig;
     int i;
 
-
     /* free the lists */
     if (sic->streamcontexts != NULL) {
         for (i = 0; i < sic->nb_inputs; i++) {
             sc = &(sic->streamcontexts[i]);
-            finsig = sc->finesiglist;
-            cousig = sc->coarsesiglist;
-
-            while (finsig) {
-                tmp = finsig;
-                finsig = finsig->next;
-                av_freep(&tmp);
-            }
-            sc->finesiglist = NULL;
-
-            while (cousig) {
-                tmp = cousig;
-                cousig = cousig->next;
-                av_freep(&tmp);
-            }
-            sc->coarsesiglist = NULL;
+            free_signatures(sc);
+            av_freep(&sc->colsums);
         }
         av_freep(&sic->streamcontexts);
     }
@@ -566,8 +696,8 @@ static int config_output(AVFilterLink *outlink)
 
 static void release_streamcontext(StreamContext *sc)
 {
-    free(sc->coarsesiglist);
-    free(sc->finesiglist);
+    av_freep(&sc->coarsesiglist);
+    av_freep(&sc->finesiglist);
 }
 
 static int get_filesize(const char *filename)
@@ -610,284 +740,491 @@ static uint8_t * get_filebuffer(const char *filename, int* fileLength)
         readLength = fread(buffer, sizeof(uint8_t), *fileLength, f);
         if(readLength != *fileLength) {
             av_log(NULL, AV_LOG_ERROR, "Could not read the file %s\n", filename);
-            free(buffer);
-            buffer = NULL;
+            av_freep(&buffer);
         }
     }
     fclose(f);
     return buffer;
 }
 
-static int binary_import(uint8_t *buffer, int fileLength, StreamContext *sc)
+/**
+ * Big endian bit reader that never reads past the end of its buffer, so
+ * unpadded buffers such as exactly sized mappings can be parsed in place.
+ * Bits past the end read as 0.
+ */
+typedef struct SignatureReader {
+    const uint8_t *buf;
+    size_t size;            ///< buffer size in bytes
+    uint64_t index;         ///< current position in bits
+} SignatureReader;
+
+static void reader_init(SignatureReader *r, const uint8_t *buf, size_t size)
+{
+    r->buf   = buf;
+    r->size  = size;
+    r->index = 0;
+}
+
+/** read 1 to 32 bits */
+static av_always_inline uint32_t reader_get(SignatureReader *r, int n)
+{
+    uint64_t pos = r->index >> 3;
+    uint64_t cache = 0;
+
+    if (pos + 8 <= r->size) {
+        cache = AV_RB64(r->buf + pos);
+    } else {
+        for (int i = 0; pos + i < r->size; i++)
+            cache |= (uint64_t)r->buf[pos + i] << (56 - 8 * i);
+    }
+    cache <<= r->index & 7;
+    r->index += n;
+    return cache >> (64 - n);
+}
+
+static void reader_skip(SignatureReader *r, int n)
+{
+    r->index += n;
+}
+
+static int64_t reader_left(const SignatureReader *r)
+{
+    return (int64_t)(r->size * 8) - (int64_t)r->index;
+}
+
+typedef struct SignatureImport {
+    StreamContext sc;
+    SignatureReader br;
+    BoundedCoarseSignature *bounds;
+    unsigned int nb_segments;
+} SignatureImport;
+
+static void release_import(SignatureImport *imp)
 {
-    int ret = 0;
+    release_streamcontext(&imp->sc);
+    av_freep(&imp->bounds);
+}
 
-    unsigned int numOfSegments = 0;
-    GetBitContext bitContext = { 0 };
+/**
+ * parse the header and the coarse signatures of a binary signature,
+ * the bit reader is left at the start of the fine signatures
+ */
+static int import_coarse(SignatureImport *imp, const uint8_t *buffer, size_t len)
+{
+    StreamContext *sc = &imp->sc;
+    SignatureReader *br = &imp->br;
     BoundedCoarseSignature *bCs;
     unsigned int i, j, k;
-    int totalLength = 8 * fileLength;
-    int finesigncount = 0;
-    BoundedCoarseSignature *bCoarseList;
 
-    if (init_get_bits(&bitContext, buffer, totalLength)) {
-        return -1;
-    }
+    if (len > INT64_MAX / 8)
+        return AVERROR_INVALIDDATA;
+    reader_init(br, buffer, len);
 
     // Skip the following data:
     // - NumOfSpatial Regions: (32 bits) only 1 supported
     // - SpatialLocationFlag: (1 bit) always the whole image
     // - PixelX_1: (16 bits) always 0
     // - PixelY_1: (16 bits) always 0
-    skip_bits(&bitContext, 32 + 1 + 16 * 2);
+    reader_skip(br, 32 + 1 + 16 * 2);
 
     // width - 1, and height - 1
     // PixelX_2: (16 bits) is width - 1
     // PixelY_2: (16 bits) is height - 1
-    sc->w = get_bits(&bitContext, 16);
-    sc->h = get_bits(&bitContext, 16);
-    ++sc->w;
-    ++sc->h;
+    sc->w = reader_get(br, 16) + 1;
+    sc->h = reader_get(br, 16) + 1;
 
     // StartFrameOfSpatialRegion, always 0
-    skip_bits(&bitContext, 32);
+    reader_skip(br, 32);
 
     // NumOfFrames
     // it's the number of fine signatures
-    sc->lastindex = get_bits_long(&bitContext, 32);
+    sc->lastindex = reader_get(br, 32);
 
     // MediaTimeUnit
     // sc->time_base.den / sc->time_base.num
     // hoping num is 1, other values are vague
-    // den/num might be greater than 16 bit, so cutting it
-    //put_bits(&buf, 16, 0xFFFF & (sc->time_base.den / sc->time_base.num));
-
-    sc->time_base.den = get_bits(&bitContext, 16);
+    sc->time_base.den = reader_get(br, 16);
     sc->time_base.num = 1;
 
     // Skip the following data
     // - MediaTimeFlagOfSpatialRegion: (1 bit) always 1
     // - StartMediaTimeOfSpatialRegion: (32 bits) always 0
     // - EndMediaTimeOfSpatialRegion: (32 bits)
-    skip_bits(&bitContext, 1 + 32*2);
+    reader_skip(br, 1 + 32*2);
 
     // Coarse signatures
     // numOfSegments = number of coarse signatures
-    numOfSegments = get_bits_long(&bitContext, 32);
-    if (numOfSegments <= 0) {
-        return -1;
-    }
+    imp->nb_segments = reader_get(br, 32);
+    if (!imp->nb_segments || imp->nb_segments > reader_left(br) / 32)
+        return AVERROR_INVALIDDATA;
 
-    sc->coarsesiglist = (CoarseSignature*)av_calloc(numOfSegments, sizeof(CoarseSignature));
-    if(sc->coarsesiglist == NULL) {
+    sc->coarsesiglist = av_calloc(imp->nb_segments, sizeof(CoarseSignature));
+    imp->bounds = av_calloc(imp->nb_segments, sizeof(BoundedCoarseSignature));
+    if (!sc->coarsesiglist || !imp->bounds)
         return AVERROR(ENOMEM);
-    }
 
-    bCoarseList = (BoundedCoarseSignature*)av_calloc(numOfSegments, sizeof(BoundedCoarseSignature));
-    if(bCoarseList == NULL) {
-        av_freep(&sc->coarsesiglist);
-        return AVERROR(ENOMEM);
-    }
-
-    // CoarseSignature loading
-    for (i = 0; i < numOfSegments; ++i) {
-        bCs = &bCoarseList[i];
+    for (i = 0; i < imp->nb_segments; i++) {
+        bCs = &imp->bounds[i];
         bCs->cSign = &sc->coarsesiglist[i];
 
-        if (i < numOfSegments - 1)
+        if (i < imp->nb_segments - 1)
             bCs->cSign->next = &sc->coarsesiglist[i + 1];
         // each coarse signature is a VSVideoSegment
         // StartFrameOfSegment
-        bCs->firstIndex = get_bits_long(&bitContext, 32);
+        bCs->firstIndex = reader_get(br, 32);
         // EndFrameOfSegment
-        bCs->lastIndex = get_bits_long(&bitContext, 32);
+        bCs->lastIndex = reader_get(br, 32);
 
         // MediaTimeFlagOfSegment 1 bit, always 1
-        skip_bits(&bitContext, 1);
+        reader_skip(br, 1);
 
         // Fine signature pts
         // StartMediaTimeOfSegment 32 bits
-        bCs->firstPts = get_bits_long(&bitContext, 32);
+        bCs->firstPts = reader_get(br, 32);
         // EndMediaTimeOfSegment 32 bits
-        bCs->lastPts = get_bits_long(&bitContext, 32);
+        bCs->lastPts = reader_get(br, 32);
         // Bag of words
-        for ( j = 0; j < 5; ++j) {
-            // read 243 bits ( = 7 * 32 + 19 = 8 * 28 + 19) into buffer
-            for ( k = 0; k < 30; ++k) {
-                // 30*8 bits = 30 bytes
-                bCs->cSign->data[j][k] = get_bits(&bitContext, 8);
-            }
-            bCs->cSign->data[j][30] = get_bits(&bitContext, 3) << 5;
+        for (j = 0; j < 5; j++) {
+            // read 243 bits ( = 30 * 8 + 3) into buffer
+            for (k = 0; k < 30; k++)
+                bCs->cSign->data[j][k] = reader_get(br, 8);
+            bCs->cSign->data[j][30] = reader_get(br, 3) << 5;
         }
         //check remain bit
-        if(totalLength - bitContext.index <= 0) {
-            av_freep(&sc->coarsesiglist);
-            av_free(bCoarseList);
-            return -1;
-        }
+        if (reader_left(br) <= 0)
+            return AVERROR_INVALIDDATA;
     }
-    sc->coarseend = &sc->coarsesiglist[numOfSegments - 1];
-
-    // Finesignatures
-    // CompressionFlag, only 0 supported
-    skip_bits(&bitContext, 1);
+    sc->coarseend = &sc->coarsesiglist[imp->nb_segments - 1];
 
+    return 0;
+}
 
-    // Check lastindex for validity
-    finesigncount = (totalLength - bitContext.index) / MPEG7_FINESIG_NBITS;
-    if (!finesigncount) {
-        av_freep(&sc->coarsesiglist);
-        av_free(bCoarseList);
-        return -1;
-    }
+/**
+ * parse the fine signatures following the coarse ones and link both
+ */
+static int import_fine(SignatureImport *imp)
+{
+    StreamContext *sc = &imp->sc;
+    SignatureReader *br = &imp->br;
+    FineSignature *fs, *lastfs;
+    uint64_t *maxpts;
+    unsigned int i, k;
 
-    if(sc->lastindex != finesigncount)
-        sc->lastindex = finesigncount;
-    sc->finesiglist = (FineSignature*)av_calloc(sc->lastindex, sizeof(FineSignature));
-    if(sc->finesiglist == NULL) {
-        av_freep(&sc->coarsesiglist);
-        av_free(bCoarseList);
+    // Finesignatures
+    // CompressionFlag, only 0 supported
+    reader_skip(br, 1);
+
+    // the NumOfFrames field is not trusted, the number of fine signatures
+    // is derived from the remaining data
+    sc->lastindex = FFMAX(reader_left(br), 0) / MPEG7_FINESIG_NBITS;
+    if (!sc->lastindex)
+        return AVERROR_INVALIDDATA;
+
+    sc->finesiglist = av_calloc(sc->lastindex, sizeof(FineSignature));
+    maxpts = av_malloc_array(sc->lastindex, sizeof(*maxpts));
+    if (!sc->finesiglist || !maxpts) {
+        av_free(maxpts);
         return AVERROR(ENOMEM);
     }
 
-    // Load fine signatures from file
-    for (i = 0; i < sc->lastindex; ++i) {
-        FineSignature *fs = &sc->finesiglist[i];
+    lastfs = sc->finesiglist;
+    for (i = 0; i < sc->lastindex; i++) {
+        fs = &sc->finesiglist[i];
 
         // MediaTimeFlagOfFrame always 1
-        skip_bits(&bitContext, 1);
+        reader_skip(br, 1);
 
         // MediaTimeOfFrame (PTS)
-        fs->pts = get_bits_long(&bitContext, 32);
+        fs->pts = reader_get(br, 32);
 
         // FrameConfidence
-        fs->confidence = get_bits(&bitContext, 8);
+        fs->confidence = reader_get(br, 8);
 
         // words
-        for (k = 0; k < 5; k++) {
-            fs->words[k] = get_bits(&bitContext, 8);
-        }
+        for (k = 0; k < 5; k++)
+            fs->words[k] = reader_get(br, 8);
         // framesignature
-        for (k = 0; k < SIGELEM_SIZE / 5; k++) {
-            fs->framesig[k] = get_bits(&bitContext, 8);
-        }
-    }
+        for (k = 0; k < SIGELEM_SIZE / 5; k++)
+            fs->framesig[k] = reader_get(br, 8);
+        fill_l1code(fs);
 
-    // Creating FineSignature linked list
-    for (i = 0; i < sc->lastindex; ++i) {
-        FineSignature *fs = &sc->finesiglist[i];
-        // Building fine signature list
-        // First element prev should be NULL
-        // Last element next should be NULL
-        if (i == 0 && sc->lastindex == 1) {
-            fs->next = NULL;
-            fs->prev = NULL;
-        } else if (i == 0) {
-            fs->next = &fs[1];
-            fs->prev = NULL;
-        }
-        else if (i == sc->lastindex - 1) {
-            fs->next = NULL;
-            fs->prev = &fs[-1];
-        }
-        else {
-            fs->next = &fs[1];
-            fs->prev = &fs[-1];
-        }
+        fs->prev = i > 0 ? &fs[-1] : NULL;
+        fs->next = i < sc->lastindex - 1 ? &fs[1] : NULL;
+
+        maxpts[i] = i > 0 ? FFMAX(maxpts[i - 1], fs->pts) : fs->pts;
+        if (fs->pts >= lastfs->pts)
+            lastfs = fs;
     }
 
     // Fine signature ranges DO overlap
-    // Assign FineSignatures to CoarseSignatures
-    for (i = 0; i < numOfSegments; ++i) {
-        BoundedCoarseSignature *bCs = &bCoarseList[i];
-        uint64_t firstpts = bCs->firstPts;
-        if (firstpts > bCs->lastPts) {
-            firstpts = bCs->lastPts;
-        }
-        for (j = 0;  j < sc->lastindex; ++j) {
-            FineSignature *fs = &sc->finesiglist[j];
-            if (fs->pts >= firstpts) {
-                // Check if the fragment's pts is inside coarse signature
-                // bounds. Upper bound is checked in for loop
-                if (!bCs->cSign->first) {
-                    bCs->cSign->first = fs;
-                }
-
-                if (bCs->cSign->last) {
-                    if (bCs->cSign->last->pts <= fs->pts)
-                        bCs->cSign->last = fs;
-                } else {
-                    bCs->cSign->last = fs;
-                }
-            }
+    // Assign FineSignatures to CoarseSignatures: the first fine signature
+    // of a segment is the first one with a pts of at least the start of the
+    // segment, which is where the running maximum of the pts reaches it.
+    for (i = 0; i < imp->nb_segments; i++) {
+        BoundedCoarseSignature *bCs = &imp->bounds[i];
+        uint64_t firstpts = FFMIN(bCs->firstPts, bCs->lastPts);
+        unsigned int lo = 0, hi = sc->lastindex;
+
+        while (lo < hi) {
+            unsigned int mid = lo + (hi - lo) / 2;
+            if (maxpts[mid] >= firstpts)
+                hi = mid;
+            else
+                lo = mid + 1;
         }
-        if(!bCs->cSign->first || !bCs->cSign->last) {
-           ret = -1;
-           break;
+        if (lo == sc->lastindex) {
+            av_free(maxpts);
+            return AVERROR_INVALIDDATA;
         }
+        // there is no upper bound, so every segment ends at the fine
+        // signature with the highest pts
+        bCs->cSign->first = &sc->finesiglist[lo];
+        bCs->cSign->last  = lastfs;
         bCs->cSign->first->index = bCs->firstIndex;
-        bCs->cSign->last->index = bCs->lastIndex;
+        bCs->cSign->last->index  = bCs->lastIndex;
     }
+    av_free(maxpts);
+
+    return 0;
+}
+
+static void init_compare_context(SignatureContext *sic, int flags)
+{
+    memset(sic, 0, sizeof(*sic));
+    sic->mode         = flags & AVFILTER_SIGN_COMPARE_FAST ? MODE_FAST : MODE_FULL;
+    sic->nb_inputs    = INPUTS_COUNT;
+    sic->thworddist   = 9000;
+    sic->thcomposdist = 60000;
+    sic->thl1         = 150;
+    sic->thdi         = 0;
+    sic->thit         = 0.5;
+}
+
+static int get_match_level(const MatchingInfo *result)
+{
+    if (!result->score)
+        return 0; // no matching
+    return result->whole ? 2 : 1; // full or partial matching
+}
+
+/**
+ * compare an already built stream against a binary signature, the fine
+ * signatures of the latter are only decoded if at least one pair of coarse
+ * signatures is close enough for the lookup to look at them
+ */
+static int compare_stream_signbuffer(AVFilterContext *ctx, SignatureContext *sic,
+                                     StreamContext *first, SignatureImport *imp, int mode)
+{
+    CoarseSignature *cs = first->coarsesiglist;
+    CoarseSignature *cs2 = imp->sc.coarsesiglist;
+    MatchingInfo result;
+    int ret;
+
+    if (!find_next_coarsecandidate(sic, cs2, &cs, &cs2, 1))
+        return 0;
+
+    if ((ret = import_fine(imp)) < 0)
+        return ret;
 
-    if(ret < 0) {
-        av_freep(&sc->coarsesiglist);
+    result = lookup_signatures(ctx, sic, first, &imp->sc, mode);
+    return get_match_level(&result);
+}
+
+static int compare_signbuffer(const uint8_t *signbuf1, size_t len1,
+                              const uint8_t *signbuf2, size_t len2, int flags)
+{
+    SignatureImport imp[INPUTS_COUNT] = { 0 };
+    SignatureContext sigContext;
+    CoarseSignature *cs, *cs2;
+    MatchingInfo result;
+    int ret;
+
+    init_compare_context(&sigContext, flags);
+
+    if ((ret = import_coarse(&imp[0], signbuf1, len1)) < 0 ||
+        (ret = import_coarse(&imp[1], signbuf2, len2)) < 0)
+        goto fail;
+
+    /* same early exit as in compare_stream_signbuffer() */
+    cs  = imp[0].sc.coarsesiglist;
+    cs2 = imp[1].sc.coarsesiglist;
+    if (!find_next_coarsecandidate(&sigContext, cs2, &cs, &cs2, 1)) {
+        ret = 0;
+        goto end;
     }
-    av_free(bCoarseList);
 
+    if ((ret = import_fine(&imp[0])) < 0 ||
+        (ret = import_fine(&imp[1])) < 0)
+        goto fail;
+
+    result = lookup_signatures(NULL, &sigContext, &imp[0].sc, &imp[1].sc, sigContext.mode);
+    ret = get_match_level(&result);
+    goto end;
+
+fail:
+    av_log(NULL, AV_LOG_ERROR, "Could not create StreamContext from binary data for signature\n");
+end:
+    release_import(&imp[0]);
+    release_import(&imp[1]);
     return ret;
 }
 
-static int compare_signbuffer(uint8_t* signbuf1, int len1, uint8_t* signbuf2, int len2) {
-    int ret = -1;
-    StreamContext scontexts[INPUTS_COUNT] = { 0 };
-    MatchingInfo result = { 0 };
-    SignatureContext sigContext = {
-        .class = NULL,
-        .mode = MODE_FULL,
-        .nb_inputs = INPUTS_COUNT,
-        .filename = NULL,
-        .thworddist = 9000,
-        .thcomposdist = 60000,
-        .thl1 = 150,
-        .thdi = 0,
-        .thit = 0.5,
-        .streamcontexts = scontexts
-    };
-    if (binary_import(signbuf1, len1, &scontexts[0]) < 0 || binary_import(signbuf2, len2, &scontexts[1]) < 0) {
-        if(scontexts[0].coarsesiglist) {
-            av_freep(&scontexts[0].coarsesiglist);
-        }
-        if(scontexts[1].coarsesiglist) {
-            av_freep(&scontexts[1].coarsesiglist);
-        }
-        av_log(NULL, AV_LOG_ERROR, "Could not create StreamContext from binary data for signature\n");
+int avfilter_compare_sign_bymem(const uint8_t *signbuf1, size_t len1,
+                                const uint8_t *signbuf2, size_t len2, int flags)
+{
+    if (!signbuf1 || !signbuf2 || !len1 || !len2)
+        return AVERROR(EINVAL);
+
+    return compare_signbuffer(signbuf1, len1, signbuf2, len2, flags);
+}
+
+int avfilter_compare_sign_byfilter(AVFilterContext *ctx, int input,
+                                   const uint8_t *signbuf, size_t len, int flags)
+{
+    SignatureImport imp = { 0 };
+    SignatureContext *sic;
+    StreamContext *sc;
+    int ret;
+
+    if (!ctx || strcmp(ctx->filter->name, "signature") || !signbuf || !len)
+        return AVERROR(EINVAL);
+    sic = ctx->priv;
+    if (input < 0 || input >= sic->nb_inputs)
+        return AVERROR(EINVAL);
+    sc = &sic->streamcontexts[input];
+
+    /* nothing signed yet */
+    if (!sc->curfinesig)
+        return 0;
+
+    if ((ret = import_coarse(&imp, signbuf, len)) < 0) {
+        release_import(&imp);
         return ret;
     }
-    result = lookup_signatures(NULL, &sigContext, &scontexts[0], &scontexts[1], MODE_FULL);
 
-    if (result.score != 0) {
-        if (result.whole) ret = 2;//full matching
-        else ret = 1; //partial matching
-    }
-    else {
-        ret = 0; //no matching
+    /* use the thresholds the filter was configured with */
+    ret = compare_stream_signbuffer(ctx, sic, sc, &imp,
+                                    flags & AVFILTER_SIGN_COMPARE_FAST ? MODE_FAST : MODE_FULL);
+
+    release_import(&imp);
+    return ret;
+}
+
+struct AVFilterSignIndex {
+    SignatureContext sic;
+    SignatureImport ref;
+};
+
+int avfilter_sign_index_alloc(AVFilterSignIndex **pindex, const uint8_t *signbuf, size_t len)
+{
+    AVFilterSignIndex *index;
+    int ret;
+
+    *pindex = NULL;
+    if (!signbuf || !len)
+        return AVERROR(EINVAL);
+
+    index = av_mallocz(sizeof(*index));
+    if (!index)
+        return AVERROR(ENOMEM);
+    init_compare_context(&index->sic, 0);
+
+    if ((ret = import_coarse(&index->ref, signbuf, len)) < 0 ||
+        (ret = import_fine(&index->ref)) < 0) {
+        avfilter_sign_index_free(&index);
+        return ret;
     }
+    /* the segment bounds are only needed while importing */
+    av_freep(&index->ref.bounds);
+
+    *pindex = index;
+    return 0;
+}
+
+void avfilter_sign_index_free(AVFilterSignIndex **pindex)
+{
+    if (!*pindex)
+        return;
+    release_import(&(*pindex)->ref);
+    av_freep(pindex);
+}
+
+int avfilter_sign_index_compare(const AVFilterSignIndex *index,
+                                const uint8_t *signbuf, size_t len, int flags)
+{
+    SignatureImport imp = { 0 };
+    int ret;
 
-    release_streamcontext(&scontexts[0]);
-    release_streamcontext(&scontexts[1]);
+    if (!index || !signbuf || !len)
+        return AVERROR(EINVAL);
 
+    ret = import_coarse(&imp, signbuf, len);
+    /* the lookup does not modify the reference nor the context, so
+     * any number of comparisons may share them */
+    if (ret >= 0)
+        ret = compare_stream_signbuffer(NULL, (SignatureContext *)&index->sic,
+                                        (StreamContext *)&index->ref.sc, &imp,
+                                        flags & AVFILTER_SIGN_COMPARE_FAST ? MODE_FAST : MODE_FULL);
+    release_import(&imp);
     return ret;
 }
 
-int avfilter_compare_sign_bybuff(uint8_t *signbuf1, int len1, uint8_t *signbuf2, int len2)
+typedef struct SignIndexBatch {
+    const AVFilterSignIndex *index;
+    const uint8_t * const *signbufs;
+    const size_t *lens;
+    int *results;
+    int flags;
+} SignIndexBatch;
+
+static void compare_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
-    int ret = -1;
+    SignIndexBatch *b = priv;
 
-    if(signbuf1 != NULL && signbuf2 != NULL && len1 > 0 && len2 > 0) {
-        ret = compare_signbuffer(signbuf1, len1, signbuf2, len2);
+    b->results[jobnr] = avfilter_sign_index_compare(b->index, b->signbufs[jobnr],
+                                                    b->lens[jobnr], b->flags);
+}
+
+int avfilter_sign_index_compare_many(const AVFilterSignIndex *index,
+                                     const uint8_t * const *signbufs, const size_t *lens,
+                                     int *results, int nb, int flags, int nb_threads)
+{
+    SignIndexBatch b = {
+        .index    = index,
+        .signbufs = signbufs,
+        .lens     = lens,
+        .results  = results,
+        .flags    = flags,
+    };
+    AVSliceThread *thread = NULL;
+    int ret;
+
+    if (!index || !signbufs || !lens || !results || nb < 0 || nb_threads < 0)
+        return AVERROR(EINVAL);
+    if (!nb)
+        return 0;
+
+    ret = nb_threads == 1 ? 1 :
+          avpriv_slicethread_create(&thread, &b, compare_worker, NULL,
+                                    nb_threads ? FFMIN(nb_threads, nb) : 0);
+    if (ret > 1) {
+        avpriv_slicethread_execute(thread, nb, 0);
+    } else {
+        /* single thread or no thread support */
+        for (int i = 0; i < nb; i++)
+            compare_worker(&b, i, 0, nb, 1);
     }
+    avpriv_slicethread_free(&thread);
 
-    return ret;
+    return 0;
+}
+
+int avfilter_compare_sign_bybuff(uint8_t *signbuf1, int len1, uint8_t *signbuf2, int len2)
+{
+    if (len1 <= 0 || len2 <= 0)
+        return -1;
+
+    return avfilter_compare_sign_bymem(signbuf1, len1, signbuf2, len2, 0);
 }
 
 int avfilter_compare_sign_bypath(char *signpath1, char *signpath2)
@@ -900,15 +1237,13 @@ int avfilter_compare_sign_bypath(char *signpath1, char *signpath2)
     if(buffer1 == NULL) return AVERROR(ENOMEM);
     buffer2 = get_filebuffer(signpath2, &len2);
     if(buffer2 == NULL) {
-        free(buffer1);
+        av_free(buffer1);
         return AVERROR(ENOMEM);
     }
-    ret = compare_signbuffer(buffer1, len1, buffer2, len2);
+    ret = compare_signbuffer(buffer1, len1, buffer2, len2, 0);
 
-    if(buffer1 != NULL)
-        free(buffer1);
-    if(buffer2 != NULL)
-        free(buffer2);
+    av_free(buffer1);
+    av_free(buffer2);
 
     return ret;
 }
@@ -929,8 +1264,9 @@ const AVFilter ff_vf_signature = {
     .priv_class    = &signature_class,
     .init          = init,
     .uninit        = uninit,
+    .process_command = process_command,
     FILTER_OUTPUTS(signature_outputs),
     .inputs        = NULL,
     FILTER_PIXFMTS_ARRAY(pix_fmts),
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
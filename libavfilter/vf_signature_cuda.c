@@ -282,7 +282,7 @@ static int cudasign_filter_frame(AVFilterLink *link, AVFrame *in)
     
     /* initialize fs */
     if (sc->curfinesig) {
-        fs = av_mallocz(sizeof(FineSignature));
+        fs = alloc_finesignature(sc);
         if (!fs)
             return AVERROR(ENOMEM);
         sc->curfinesig->next = fs;
@@ -564,12 +564,12 @@ static av_cold int cudasign_init(AVFilterContext *ctx)
     sc = s->streamcontexts;
 
     sc->lastindex = 0;
-    sc->finesiglist = av_mallocz(sizeof(FineSignature));
+    sc->finesiglist = alloc_finesignature(sc);
     if (!sc->finesiglist)
         return AVERROR(ENOMEM);
     sc->curfinesig = NULL;
 
-    sc->coarsesiglist = av_mallocz(sizeof(CoarseSignature));
+    sc->coarsesiglist = alloc_coarsesignature(sc);
     if (!sc->coarsesiglist)
         return AVERROR(ENOMEM);
     sc->curcoarsesig1 = sc->coarsesiglist;
@@ -584,9 +584,6 @@ static av_cold void cudasign_uninit(AVFilterContext *ctx)
 {
     CUDASignContext *s = ctx->priv;
     StreamContext *sc;
-    FineSignature* finsig;
-    CoarseSignature* cousig;
-    void* tmp;
 
     if (s->hwctx && s->cu_module) {
         CudaFunctions *cu = s->hwctx->internal->cuda_dl;
@@ -615,22 +612,7 @@ static av_cold void cudasign_uninit(AVFilterContext *ctx)
             sc->exported = 1;
         }
 
-        finsig = sc->finesiglist;
-        cousig = sc->coarsesiglist;
-
-        while (finsig) {
-            tmp = finsig;
-            finsig = finsig->next;
-            av_freep(&tmp);
-        }
-        sc->finesiglist = NULL;
-
-        while (cousig) {
-            tmp = cousig;
-            cousig = cousig->next;
-            av_freep(&tmp);
-        }
-        sc->coarsesiglist = NULL;        
+        free_signatures(sc);
         av_freep(&s->streamcontexts);
     }    
 }
@@ -453,15 +453,14 @@ static int flush_dynbuf(DASHContext *c, OutputStream *os, int *range_length)
 
     if (!c->single_file) {
         // write out to file
-        *range_length = avio_close_dyn_buf(os->ctx->pb, &buffer);
-        os->ctx->pb = NULL;
+        *range_length = avio_get_dyn_buf(os->ctx->pb, &buffer);
         if (os->out)
             avio_write(os->out, buffer + os->written_len, *range_length - os->written_len);
         os->written_len = 0;
-        av_free(buffer);
 
-        // re-open buffer
-        return avio_open_dyn_buf(&os->ctx->pb);
+        // reuse the buffer for the next segment
+        ffio_reset_dyn_buf(os->ctx->pb);
+        return 0;
     } else {
         *range_length = avio_tell(os->ctx->pb) - os->pos;
         return 0;
@@ -1636,7 +1635,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             if (c->streaming)
                 // skip_sidx : Reduce bitrate overhead
                 // skip_trailer : Avoids growing memory usage with time
-                av_dict_set(&opts, "movflags", "+dash+delay_moov+skip_sidx+skip_trailer", AV_DICT_APPEND);
+                // chunked : Output every fragment as soon as it is complete
+                av_dict_set(&opts, "movflags", "+dash+delay_moov+skip_sidx+skip_trailer+chunked", AV_DICT_APPEND);
             else {
                 if (c->global_sidx)
                     av_dict_set(&opts, "movflags", "+dash+delay_moov+global_sidx+skip_trailer", AV_DICT_APPEND);
@@ -2279,17 +2279,18 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
-    //write out the data immediately in streaming mode
+    //write out every chunk as soon as it is complete in streaming mode
     if (c->streaming && os->segment_type == SEGMENT_TYPE_MP4) {
         int len = 0;
         uint8_t *buf = NULL;
-        avio_flush(os->ctx->pb);
-        len = avio_get_dyn_buf (os->ctx->pb, &buf);
-        if (os->out) {
-            avio_write(os->out, buf + os->written_len, len - os->written_len);
-            avio_flush(os->out);
+        len = avio_get_dyn_buf(os->ctx->pb, &buf);
+        if (len > os->written_len) {
+            if (os->out) {
+                avio_write(os->out, buf + os->written_len, len - os->written_len);
+                avio_flush(os->out);
+            }
+            os->written_len = len;
         }
-        os->written_len = len;
     }
 
     return ret;
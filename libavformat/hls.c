@@ -33,10 +33,12 @@
 #include "libavutil/aes.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "demux.h"
@@ -48,6 +50,7 @@
 #include "hls_sample_encryption.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define MAX_INIT_SECTION_SIZE (1024 * 1024)
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -87,6 +90,73 @@ struct segment {
 
 struct rendition;
 
+#if HAVE_THREADS
+/* A segment downloaded ahead of the reader by the prefetch thread. */
+struct prefetch_slot {
+    int64_t seq_no;
+    /* 0 while downloading, 1 when complete, < 0 ends the playlist */
+    int status;
+
+    /* Media Initialization Section of the segment, with its data if it
+     * differs from the one of the previous slot */
+    struct segment *init_section;
+    uint8_t *init_data;
+    unsigned int init_data_size;
+    int init_data_len;
+
+    uint8_t *data;
+    unsigned int data_size;
+    int data_len;
+    int read_pos;
+};
+
+/*
+ * Prefetching state of a playlist. The slots are a ring of at most
+ * prefetch_segments entries filled by the prefetch thread and consumed by
+ * the reader. The fields shared by both are protected by
+ * HLSContext.prefetch_lock.
+ */
+struct playlist_prefetch {
+    /* the playlist is read without prefetching, only used by the reader */
+    int disabled;
+
+    int active;
+    /* incremented by the reader whenever it drops the prefetched data */
+    unsigned int gen;
+    /* next segment to download */
+    int64_t seq_no;
+
+    struct prefetch_slot *slots;
+    int head;
+    int nb_slots;
+    /* the reader has started consuming the head slot */
+    int head_started;
+
+    /* refreshed playlist waiting to be parsed by the reader */
+    int playlist_pending;
+    uint8_t *playlist_buf;
+    int playlist_len;
+    char *playlist_url;
+
+    /* worker private */
+    unsigned int worker_gen;
+    int downloading;
+    int64_t remaining;
+    int keepalive;
+    int retries;
+    int reloads;
+    int64_t last_reload_time;
+    struct segment *init_section;
+    uint8_t *init_buf;
+    unsigned int init_buf_size;
+    AVIOContext *input;
+    AVIOContext *playlist_pb;
+    /* AES-128 key of the segments being downloaded */
+    char key_url[MAX_URL_SIZE];
+    uint8_t key[16];
+};
+#endif
+
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
     PLS_TYPE_EVENT,
@@ -172,6 +242,10 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+#if HAVE_THREADS
+    struct playlist_prefetch prefetch;
+#endif
 };
 
 /*
@@ -219,6 +293,7 @@ typedef struct HLSContext {
     int64_t first_timestamp;
     int64_t cur_timestamp;
     AVIOInterruptCB *interrupt_callback;
+    /* shared with the prefetch thread, see get_avio_opts() */
     AVDictionary *avio_opts;
     AVDictionary *seg_format_opts;
     char *allowed_extensions;
@@ -229,6 +304,19 @@ typedef struct HLSContext {
     int seg_max_retry;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
+
+    int prefetch_segments;
+#if HAVE_THREADS
+    int prefetch_initialized;
+    int prefetch_thread_created;
+    int prefetch_abort;
+    pthread_t prefetch_thread;
+    pthread_mutex_t prefetch_lock;
+    /* wakes the prefetch thread */
+    pthread_cond_t prefetch_cond;
+    /* wakes the reader */
+    pthread_cond_t prefetch_data_cond;
+#endif
 } HLSContext;
 
 static void free_segment_dynarray(struct segment **segments, int n_segments)
@@ -260,11 +348,34 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+#if HAVE_THREADS
+static void free_prefetch(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+
+    if (pf->slots) {
+        for (int i = 0; i < c->prefetch_segments; i++) {
+            av_freep(&pf->slots[i].init_data);
+            av_freep(&pf->slots[i].data);
+        }
+        av_freep(&pf->slots);
+    }
+    av_freep(&pf->playlist_buf);
+    av_freep(&pf->playlist_url);
+    av_freep(&pf->init_buf);
+    ff_format_io_close(c->ctx, &pf->input);
+    ff_format_io_close(c->ctx, &pf->playlist_pb);
+}
+#endif
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+#if HAVE_THREADS
+        free_prefetch(c, pls);
+#endif
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -643,6 +754,41 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
+/*
+ * The prefetch thread sends requests too, so once it may be running the
+ * shared options, which collect the cookies set by the servers, are only
+ * accessed under the lock. Every request works on its own copy.
+ */
+static int get_avio_opts(HLSContext *c, AVDictionary **opts)
+{
+    int ret;
+
+#if HAVE_THREADS
+    if (c->prefetch_initialized)
+        pthread_mutex_lock(&c->prefetch_lock);
+#endif
+    ret = av_dict_copy(opts, c->avio_opts, 0);
+#if HAVE_THREADS
+    if (c->prefetch_initialized)
+        pthread_mutex_unlock(&c->prefetch_lock);
+#endif
+
+    return ret;
+}
+
+static void set_cookies(HLSContext *c, const char *cookies)
+{
+#if HAVE_THREADS
+    if (c->prefetch_initialized)
+        pthread_mutex_lock(&c->prefetch_lock);
+#endif
+    av_dict_set(&c->avio_opts, "cookies", cookies, 0);
+#if HAVE_THREADS
+    if (c->prefetch_initialized)
+        pthread_mutex_unlock(&c->prefetch_lock);
+#endif
+}
+
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
 {
@@ -718,8 +864,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
         if (!(s->flags & AVFMT_FLAG_CUSTOM_IO))
             av_opt_get(*pb, "cookies", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&new_cookies);
 
-        if (new_cookies)
+        if (new_cookies) {
+            set_cookies(c, new_cookies);
             av_dict_set(opts, "cookies", new_cookies, AV_DICT_DONT_STRDUP_VAL);
+        }
     }
 
     av_dict_free(&tmp);
@@ -769,8 +917,11 @@ static int parse_playlist(HLSContext *c, const char *url,
 
     if (!in) {
         AVDictionary *opts = NULL;
-        av_dict_copy(&opts, c->avio_opts, 0);
 
+        if ((ret = get_avio_opts(c, &opts)) < 0) {
+            av_dict_free(&opts);
+            return ret;
+        }
         if (c->http_persistent)
             av_dict_set(&opts, "multiple_requests", "1", 0);
 
@@ -1049,7 +1200,8 @@ fail:
 static struct segment *current_segment(struct playlist *pls)
 {
     int64_t n = pls->cur_seq_no - pls->start_seq_no;
-    if (n >= pls->n_segments)
+    /* a prefetched segment may already have expired from the playlist */
+    if (n < 0 || n >= pls->n_segments)
         return NULL;
     return pls->segments[n];
 }
@@ -1062,11 +1214,20 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+#if HAVE_THREADS
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size);
+#endif
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
     int ret;
 
+#if HAVE_THREADS
+    if (pls->prefetch.active)
+        return prefetch_read(pls, buf, buf_size);
+#endif
+
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
@@ -1214,7 +1375,7 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
             break;
 
         if (ff_id3v2_match(buf, ID3v2_DEFAULT_MAGIC)) {
-            int64_t maxsize = seg->size >= 0 ? seg->size : 1024*1024;
+            int64_t maxsize = seg && seg->size >= 0 ? seg->size : 1024*1024;
             int taglen = ff_id3v2_tag_len(buf);
             int tag_got_bytes = FFMIN(taglen, *len);
             int remaining = taglen - tag_got_bytes;
@@ -1279,12 +1440,19 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+/* key and key_url cache the AES-128 key, they belong to the calling thread */
+static int open_segment_input(HLSContext *c, struct playlist *pls, struct segment *seg,
+                              AVIOContext **in, uint8_t key[16],
+                              char key_url[MAX_URL_SIZE])
 {
+    AVDictionary *avio_opts = NULL;
     AVDictionary *opts = NULL;
     int ret;
     int is_http = 0;
 
+    if ((ret = get_avio_opts(c, &avio_opts)) < 0)
+        goto cleanup;
+
     if (c->http_persistent)
         av_dict_set(&opts, "multiple_requests", "1", 0);
 
@@ -1299,11 +1467,11 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_AES_128 || seg->key_type == KEY_SAMPLE_AES) {
-        if (strcmp(seg->key, pls->key_url)) {
+        if (strcmp(seg->key, key_url)) {
             AVIOContext *pb = NULL;
-            if (open_url(pls->parent, &pb, seg->key, &c->avio_opts, opts, NULL) == 0) {
-                ret = avio_read(pb, pls->key, sizeof(pls->key));
-                if (ret != sizeof(pls->key)) {
+            if (open_url(pls->parent, &pb, seg->key, &avio_opts, opts, NULL) == 0) {
+                ret = avio_read(pb, key, 16);
+                if (ret != 16) {
                     av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
                            seg->key);
                 }
@@ -1312,29 +1480,29 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
                 av_log(pls->parent, AV_LOG_ERROR, "Unable to open key file %s\n",
                        seg->key);
             }
-            av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
+            av_strlcpy(key_url, seg->key, MAX_URL_SIZE);
         }
     }
 
     if (seg->key_type == KEY_AES_128) {
-        char iv[33], key[33], url[MAX_URL_SIZE];
+        char iv[33], hex_key[33], url[MAX_URL_SIZE];
         ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
+        ff_data_to_hex(hex_key, key, 16, 0);
         if (strstr(seg->url, "://"))
             snprintf(url, sizeof(url), "crypto+%s", seg->url);
         else
             snprintf(url, sizeof(url), "crypto:%s", seg->url);
 
-        av_dict_set(&opts, "key", key, 0);
+        av_dict_set(&opts, "key", hex_key, 0);
         av_dict_set(&opts, "iv", iv, 0);
 
-        ret = open_url(pls->parent, in, url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, url, &avio_opts, opts, &is_http);
         if (ret < 0) {
             goto cleanup;
         }
         ret = 0;
     } else {
-        ret = open_url(pls->parent, in, seg->url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, &avio_opts, opts, &is_http);
     }
 
     /* Seek to the requested position. If this was a HTTP request, the offset
@@ -1357,14 +1525,19 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
     }
 
 cleanup:
+    av_dict_free(&avio_opts);
     av_dict_free(&opts);
-    pls->cur_seg_offset = 0;
     return ret;
 }
 
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+{
+    pls->cur_seg_offset = 0;
+    return open_segment_input(c, pls, seg, in, pls->key, pls->key_url);
+}
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
-    static const int max_init_section_size = 1024*1024;
     HLSContext *c = pls->parent->priv_data;
     int64_t sec_size;
     int64_t urlsize;
@@ -1391,13 +1564,13 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     else if ((urlsize = avio_size(pls->input)) >= 0)
         sec_size = urlsize;
     else
-        sec_size = max_init_section_size;
+        sec_size = MAX_INIT_SECTION_SIZE;
 
     av_log(pls->parent, AV_LOG_DEBUG,
            "Downloading an initialization section of size %"PRId64"\n",
            sec_size);
 
-    sec_size = FFMIN(sec_size, max_init_section_size);
+    sec_size = FFMIN(sec_size, MAX_INIT_SECTION_SIZE);
 
     av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, sec_size);
 
@@ -1472,6 +1645,669 @@ static int playlist_needed(struct playlist *pls)
     return 0;
 }
 
+#if HAVE_THREADS
+/*
+ * Segment prefetching: a single thread downloads the upcoming segments of all
+ * active playlists into memory and refreshes live playlists, so the reader
+ * only copies data out of the slots. The thread only reads the playlist
+ * structures, under the lock; refreshed playlists are parsed by the reader.
+ */
+
+/* largest single read of the prefetch thread, so it can take turns serving
+ * several playlists */
+#define PREFETCH_CHUNK_SIZE (64 * 1024)
+
+enum PrefetchStep {
+    PREFETCH_IDLE,
+    PREFETCH_BUSY,
+    /* waiting until a playlist is due for a reload */
+    PREFETCH_WAIT,
+};
+
+static void prefetch_wait(pthread_cond_t *cond, pthread_mutex_t *lock)
+{
+    int64_t t = av_gettime() + 100000;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+    pthread_cond_timedwait(cond, lock, &tv);
+}
+
+static struct prefetch_slot *prefetch_tail(HLSContext *c, struct playlist_prefetch *pf)
+{
+    return &pf->slots[(pf->head + pf->nb_slots - 1) % c->prefetch_segments];
+}
+
+static struct prefetch_slot *prefetch_push(HLSContext *c, struct playlist_prefetch *pf,
+                                           int64_t seq_no, int status)
+{
+    struct prefetch_slot *slot = &pf->slots[(pf->head + pf->nb_slots) % c->prefetch_segments];
+
+    pf->nb_slots++;
+    slot->seq_no        = seq_no;
+    slot->status        = status;
+    slot->init_section  = pf->init_section;
+    slot->init_data_len = -1;
+    slot->data_len      = 0;
+    slot->read_pos      = 0;
+
+    pthread_cond_signal(&c->prefetch_data_cond);
+    return slot;
+}
+
+static void prefetch_close_input(HLSContext *c, struct playlist_prefetch *pf)
+{
+    AVIOContext *in = pf->input;
+
+    pf->input = NULL;
+    pthread_mutex_unlock(&c->prefetch_lock);
+    ff_format_io_close(c->ctx, &in);
+    pthread_mutex_lock(&c->prefetch_lock);
+}
+
+static int prefetch_download(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    struct prefetch_slot *slot = prefetch_tail(c, pf);
+    unsigned int gen = pf->gen;
+    int size = PREFETCH_CHUNK_SIZE;
+    int ret;
+
+    if (pf->remaining >= 0)
+        size = FFMIN(size, pf->remaining);
+
+    if (slot->data_len > INT_MAX - size) {
+        ret = AVERROR(ENOMEM);
+    } else if (slot->data_len + size > slot->data_size) {
+        /* the slots keep their buffers, so this only happens until they have
+         * grown to the segment size */
+        uint8_t *data = av_fast_realloc(slot->data, &slot->data_size,
+                                        FFMAX(slot->data_len + size,
+                                              FFMIN(2LL * slot->data_size, INT_MAX)));
+        ret = data ? 0 : AVERROR(ENOMEM);
+        if (data)
+            slot->data = data;
+    } else {
+        ret = 0;
+    }
+
+    if (ret >= 0) {
+        /* only the reader drops slots, and it never frees their buffers, so
+         * they can be written without holding the lock */
+        uint8_t *dst = slot->data + slot->data_len;
+
+        pthread_mutex_unlock(&c->prefetch_lock);
+        ret = size > 0 ? avio_read(pf->input, dst, size) : AVERROR_EOF;
+        pthread_mutex_lock(&c->prefetch_lock);
+
+        if (gen != pf->gen)
+            return PREFETCH_BUSY;
+    }
+
+    if (ret > 0) {
+        slot->data_len += ret;
+        if (pf->remaining >= 0)
+            pf->remaining -= ret;
+    } else {
+        /* as with direct reads, an error ends the segment */
+        slot->status    = ret == AVERROR(ENOMEM) ? ret : 1;
+        pf->downloading = 0;
+        if (!pf->keepalive)
+            prefetch_close_input(c, pf);
+    }
+
+    pthread_cond_signal(&c->prefetch_data_cond);
+    return PREFETCH_BUSY;
+}
+
+static int prefetch_init_section(HLSContext *c, struct playlist *pls,
+                                 struct segment *init_section)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    AVIOContext *in = NULL;
+    int64_t sec_size, urlsize;
+    int ret;
+
+    ret = open_segment_input(c, pls, init_section, &in, pf->key, pf->key_url);
+    if (ret < 0) {
+        av_log(pls->parent, AV_LOG_WARNING,
+               "Failed to open an initialization section in playlist %d\n",
+               pls->index);
+        return ret;
+    }
+
+    if (init_section->size >= 0)
+        sec_size = init_section->size;
+    else if ((urlsize = avio_size(in)) >= 0)
+        sec_size = urlsize;
+    else
+        sec_size = MAX_INIT_SECTION_SIZE;
+
+    sec_size = FFMIN(sec_size, MAX_INIT_SECTION_SIZE);
+
+    av_fast_malloc(&pf->init_buf, &pf->init_buf_size, sec_size);
+    ret = pf->init_buf ? avio_read(in, pf->init_buf, sec_size) : AVERROR(ENOMEM);
+    ff_format_io_close(pls->parent, &in);
+
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int prefetch_open_segment(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    const struct segment *cur = pls->segments[pf->seq_no - pls->start_seq_no];
+    struct segment seg = *cur;
+    struct prefetch_slot *slot;
+    unsigned int gen = pf->gen;
+    int64_t seq_no = pf->seq_no;
+    int init_changed = seg.init_section != pf->init_section;
+    int init_len = 0;
+    int keepalive;
+    int ret = 0;
+
+    if (seg.key_type == KEY_SAMPLE_AES) {
+        av_log(pls->parent, AV_LOG_ERROR,
+               "SAMPLE-AES segments of playlist %d can not be prefetched\n", pls->index);
+        prefetch_push(c, pf, seq_no, AVERROR_PATCHWELCOME);
+        return PREFETCH_BUSY;
+    }
+
+    /* the segment list may be replaced while the lock is released */
+    seg.url = av_strdup(cur->url);
+    seg.key = cur->key ? av_strdup(cur->key) : NULL;
+    if (!seg.url || (cur->key && !seg.key)) {
+        av_free(seg.url);
+        av_free(seg.key);
+        prefetch_push(c, pf, seq_no, AVERROR(ENOMEM));
+        return PREFETCH_BUSY;
+    }
+    keepalive = c->http_persistent && seg.key_type == KEY_NONE &&
+                av_strstart(seg.url, "http", NULL);
+
+    pthread_mutex_unlock(&c->prefetch_lock);
+    if (init_changed && seg.init_section)
+        ret = init_len = prefetch_init_section(c, pls, seg.init_section);
+    /* pf->input is only still open as a persistent HTTP connection */
+    if (ret >= 0)
+        ret = open_segment_input(c, pls, &seg, &pf->input, pf->key, pf->key_url);
+    pthread_mutex_lock(&c->prefetch_lock);
+
+    av_free(seg.url);
+    av_free(seg.key);
+
+    if (gen != pf->gen)
+        return PREFETCH_BUSY;
+
+    if (ret < 0) {
+        if (ret == AVERROR_EXIT || ff_check_interrupt(c->interrupt_callback)) {
+            prefetch_push(c, pf, seq_no, AVERROR_EXIT);
+            return PREFETCH_BUSY;
+        }
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to open segment %"PRId64" of playlist %d\n",
+               seq_no, pls->index);
+        if (pf->retries >= c->seg_max_retry) {
+            av_log(pls->parent, AV_LOG_WARNING, "Segment %"PRId64" of playlist %d failed too many times, skipping\n",
+                   seq_no, pls->index);
+            pf->seq_no++;
+            pf->retries = 0;
+        } else {
+            pf->retries++;
+        }
+        return PREFETCH_BUSY;
+    }
+
+    pf->seq_no      = seq_no + 1;
+    pf->retries     = 0;
+    pf->reloads     = 0;
+    pf->keepalive   = keepalive;
+    pf->remaining   = seg.size;
+    pf->downloading = 1;
+
+    if (init_changed)
+        pf->init_section = seg.init_section;
+    slot = prefetch_push(c, pf, seq_no, 0);
+    if (init_changed) {
+        FFSWAP(uint8_t *, slot->init_data, pf->init_buf);
+        FFSWAP(unsigned int, slot->init_data_size, pf->init_buf_size);
+        slot->init_data_len = init_len;
+    }
+
+    return PREFETCH_BUSY;
+}
+
+static int prefetch_fetch_playlist(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    int is_http = av_strstart(pls->url, "http", NULL);
+    AVIOContext *in = NULL;
+    char *new_url = NULL;
+    AVBPrint bp;
+    int ret;
+
+    if (is_http && c->http_persistent && pf->playlist_pb) {
+        ret = open_url_keepalive(c->ctx, &pf->playlist_pb, pls->url, NULL);
+        if (ret == AVERROR_EXIT)
+            return ret;
+        if (ret >= 0)
+            in = pf->playlist_pb;
+    }
+
+    if (!in) {
+        AVDictionary *opts = NULL;
+
+        if ((ret = get_avio_opts(c, &opts)) < 0) {
+            av_dict_free(&opts);
+            return ret;
+        }
+        if (c->http_persistent)
+            av_dict_set(&opts, "multiple_requests", "1", 0);
+
+        ret = c->ctx->io_open(c->ctx, &in, pls->url, AVIO_FLAG_READ, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+            return ret;
+
+        if (is_http && c->http_persistent)
+            pf->playlist_pb = in;
+    }
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ret = avio_read_to_bprint(in, &bp, SIZE_MAX);
+    if (ret >= 0 && !av_bprint_is_complete(&bp))
+        ret = AVERROR(ENOMEM);
+
+    av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&new_url);
+    if (in != pf->playlist_pb)
+        ff_format_io_close(c->ctx, &in);
+
+    av_freep(&pf->playlist_buf);
+    av_freep(&pf->playlist_url);
+    pf->playlist_url = new_url;
+    pf->playlist_len = bp.len;
+    if (ret < 0) {
+        av_bprint_finalize(&bp, NULL);
+        return ret;
+    }
+    return av_bprint_finalize(&bp, (char **)&pf->playlist_buf);
+}
+
+static int prefetch_reload(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    unsigned int gen = pf->gen;
+    int ret;
+
+    pf->reloads++;
+    pf->last_reload_time = av_gettime_relative();
+
+    pthread_mutex_unlock(&c->prefetch_lock);
+    ret = prefetch_fetch_playlist(c, pls);
+    pthread_mutex_lock(&c->prefetch_lock);
+
+    if (gen != pf->gen)
+        return PREFETCH_BUSY;
+
+    if (ret < 0) {
+        if (ret == AVERROR_EXIT) {
+            prefetch_push(c, pf, pf->seq_no, ret);
+        } else {
+            av_log(pls->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
+                   pls->index);
+        }
+        return PREFETCH_BUSY;
+    }
+
+    pf->playlist_pending = 1;
+    pthread_cond_signal(&c->prefetch_data_cond);
+    return PREFETCH_BUSY;
+}
+
+static int prefetch_step(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    int64_t end_seq_no;
+
+    if (pf->worker_gen != pf->gen) {
+        /* the reader dropped everything, start over */
+        pf->worker_gen   = pf->gen;
+        pf->downloading  = 0;
+        pf->keepalive    = 0;
+        pf->retries      = 0;
+        pf->reloads      = 0;
+        pf->init_section = NULL;
+        if (pf->input) {
+            prefetch_close_input(c, pf);
+            return PREFETCH_BUSY;
+        }
+    }
+
+    if (!pf->active)
+        return PREFETCH_IDLE;
+
+    if (pf->downloading)
+        return prefetch_download(c, pls);
+
+    if (pf->nb_slots == c->prefetch_segments ||
+        (pf->nb_slots && prefetch_tail(c, pf)->status < 0))
+        return PREFETCH_IDLE;
+
+    if (pf->seq_no < pls->start_seq_no) {
+        av_log(pls->parent, AV_LOG_WARNING,
+               "skipping %"PRId64" segments ahead, expired from playlists\n",
+               pls->start_seq_no - pf->seq_no);
+        pf->seq_no = pls->start_seq_no;
+    }
+    end_seq_no = pls->start_seq_no + pls->n_segments;
+
+    /* reload live playlists at the same pace as the reader does without
+     * prefetching, but download the known segments meanwhile */
+    if (!pls->finished && !pf->playlist_pending) {
+        int64_t reload_interval = pf->reloads ? pls->target_duration / 2 :
+                                                default_reload_interval(pls);
+        int64_t last_load_time  = FFMAX(pls->last_load_time, pf->last_reload_time);
+
+        if (av_gettime_relative() - last_load_time >= reload_interval) {
+            if (pf->seq_no >= end_seq_no &&
+                pf->reloads >= FFMIN(c->max_reload, c->m3u8_hold_counters)) {
+                prefetch_push(c, pf, pf->seq_no, AVERROR_EOF);
+                return PREFETCH_BUSY;
+            }
+            return prefetch_reload(c, pls);
+        }
+    }
+
+    if (pf->seq_no < end_seq_no)
+        return prefetch_open_segment(c, pls);
+
+    if (pls->finished) {
+        prefetch_push(c, pf, pf->seq_no, AVERROR_EOF);
+        return PREFETCH_BUSY;
+    }
+
+    /* a pending playlist is parsed by the reader, which wakes us up */
+    return pf->playlist_pending ? PREFETCH_IDLE : PREFETCH_WAIT;
+}
+
+static void *prefetch_worker(void *arg)
+{
+    HLSContext *c = arg;
+
+    ff_thread_setname("hls-prefetch");
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    while (!c->prefetch_abort) {
+        int busy = 0, wait = 0;
+
+        for (int i = 0; i < c->n_playlists && !c->prefetch_abort; i++) {
+            int ret = prefetch_step(c, c->playlists[i]);
+            busy |= ret == PREFETCH_BUSY;
+            wait |= ret == PREFETCH_WAIT;
+        }
+
+        if (busy || c->prefetch_abort)
+            continue;
+        if (wait)
+            prefetch_wait(&c->prefetch_cond, &c->prefetch_lock);
+        else
+            pthread_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    }
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    return NULL;
+}
+
+static int prefetch_start(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    int ret;
+
+    if (!pf->slots) {
+        pf->slots = av_calloc(c->prefetch_segments, sizeof(*pf->slots));
+        if (!pf->slots)
+            return AVERROR(ENOMEM);
+    }
+
+    if (!c->prefetch_thread_created) {
+        ret = pthread_create(&c->prefetch_thread, NULL, prefetch_worker, c);
+        if (ret) {
+            av_log(pls->parent, AV_LOG_ERROR, "pthread_create failed: %s\n",
+                   av_err2str(AVERROR(ret)));
+            return AVERROR(ret);
+        }
+        c->prefetch_thread_created = 1;
+    }
+
+    pf->active = 1;
+    pf->gen++;
+    pf->seq_no = pls->cur_seq_no;
+    pthread_cond_signal(&c->prefetch_cond);
+
+    return 0;
+}
+
+static void prefetch_reset(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+
+    pf->active           = 0;
+    pf->gen++;
+    pf->head             = 0;
+    pf->nb_slots         = 0;
+    pf->head_started     = 0;
+    pf->playlist_pending = 0;
+    pthread_cond_signal(&c->prefetch_cond);
+}
+
+static void prefetch_stop(HLSContext *c, struct playlist *pls)
+{
+    if (!c->prefetch_initialized)
+        return;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    prefetch_reset(c, pls);
+    pthread_mutex_unlock(&c->prefetch_lock);
+}
+
+static void prefetch_parse_playlist(HLSContext *c, struct playlist *pls)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+    FFIOContext pb;
+    int ret;
+
+    if (!pf->playlist_pending)
+        return;
+
+    ffio_init_read_context(&pb, pf->playlist_buf, pf->playlist_len);
+    ret = parse_playlist(c, pf->playlist_url ? pf->playlist_url : pls->url,
+                         pls, &pb.pub);
+    if (ret < 0)
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
+               pls->index);
+
+    pf->playlist_pending = 0;
+    pthread_cond_signal(&c->prefetch_cond);
+}
+
+/* Copy data out of the head slot, waiting for it if needed. */
+static int prefetch_read_locked(HLSContext *c, struct playlist *pls,
+                                uint8_t *buf, int buf_size)
+{
+    struct playlist_prefetch *pf = &pls->prefetch;
+
+    while (1) {
+        struct prefetch_slot *slot;
+
+        if (!pf->nb_slots || !pf->head_started)
+            return AVERROR_EOF;
+
+        slot = &pf->slots[pf->head];
+        if (slot->read_pos < slot->data_len) {
+            int size = FFMIN(buf_size, slot->data_len - slot->read_pos);
+            memcpy(buf, slot->data + slot->read_pos, size);
+            slot->read_pos += size;
+            return size;
+        }
+        if (slot->status)
+            return AVERROR_EOF;
+
+        if (ff_check_interrupt(c->interrupt_callback))
+            return AVERROR_EXIT;
+        prefetch_wait(&c->prefetch_data_cond, &c->prefetch_lock);
+    }
+}
+
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size)
+{
+    HLSContext *c = pls->parent->priv_data;
+    int ret;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    ret = prefetch_read_locked(c, pls, buf, buf_size);
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    return ret;
+}
+
+static int read_data_prefetch(struct playlist *v, uint8_t *buf, int buf_size)
+{
+    HLSContext *c = v->parent->priv_data;
+    struct playlist_prefetch *pf = &v->prefetch;
+    int just_opened = 0;
+    int ret;
+
+    if (!v->needed)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    while (1) {
+        struct prefetch_slot *slot;
+
+        if (!pf->active && (ret = prefetch_start(c, v)) < 0)
+            break;
+
+        prefetch_parse_playlist(c, v);
+
+        if (!pf->nb_slots) {
+            if (ff_check_interrupt(c->interrupt_callback)) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+            prefetch_wait(&c->prefetch_data_cond, &c->prefetch_lock);
+            continue;
+        }
+
+        slot = &pf->slots[pf->head];
+        if (slot->status < 0) {
+            ret = slot->status;
+            break;
+        }
+
+        if (!pf->head_started) {
+            /* Check that the playlist is still needed before starting a new
+             * segment. */
+            v->needed = playlist_needed(v);
+            if (!v->needed) {
+                av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d ('%s')\n",
+                       v->index, v->url);
+                prefetch_reset(c, v);
+                ret = AVERROR_EOF;
+                break;
+            }
+
+            v->cur_seq_no = slot->seq_no;
+
+            if (slot->init_data_len >= 0 && slot->init_section != v->cur_init_section) {
+                v->cur_init_section         = slot->init_section;
+                v->init_sec_data_len        = 0;
+                v->init_sec_buf_read_offset = 0;
+                if (slot->init_section) {
+                    av_fast_malloc(&v->init_sec_buf, &v->init_sec_buf_size, slot->init_data_len);
+                    if (!v->init_sec_buf) {
+                        ret = AVERROR(ENOMEM);
+                        break;
+                    }
+                    memcpy(v->init_sec_buf, slot->init_data, slot->init_data_len);
+                    v->init_sec_data_len = slot->init_data_len;
+                    /* spec says audio elementary streams do not have media
+                     * initialization sections, so there should be no ID3
+                     * timestamps */
+                    v->is_id3_timestamped = 0;
+                }
+            }
+
+            pf->head_started = 1;
+            just_opened = 1;
+        }
+
+        if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
+            /* Push init section out first before first actual segment */
+            int copy_size = FFMIN(v->init_sec_data_len - v->init_sec_buf_read_offset, buf_size);
+            memcpy(buf, v->init_sec_buf, copy_size);
+            v->init_sec_buf_read_offset += copy_size;
+            just_opened = 0;
+            ret = copy_size;
+            break;
+        }
+
+        ret = prefetch_read_locked(c, v, buf, buf_size);
+        if (ret != AVERROR_EOF)
+            break;
+
+        /* the segment is complete, hand the slot back */
+        pf->head = (pf->head + 1) % c->prefetch_segments;
+        pf->nb_slots--;
+        pf->head_started = 0;
+        pthread_cond_signal(&c->prefetch_cond);
+
+        v->cur_seq_no++;
+        c->cur_seq_no = v->cur_seq_no;
+    }
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    if (ret > 0 && just_opened && v->is_id3_timestamped != 0) {
+        /* Intercept ID3 tags here, elementary audio streams are required
+         * to convey timestamps using them in the beginning of each segment. */
+        intercept_id3(v, buf, buf_size, &ret);
+    }
+
+    return ret;
+}
+
+static int prefetch_init(AVFormatContext *s)
+{
+    HLSContext *c = s->priv_data;
+    int ret;
+
+    if ((ret = pthread_mutex_init(&c->prefetch_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&c->prefetch_cond, NULL))) {
+        pthread_mutex_destroy(&c->prefetch_lock);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&c->prefetch_data_cond, NULL))) {
+        pthread_cond_destroy(&c->prefetch_cond);
+        pthread_mutex_destroy(&c->prefetch_lock);
+        return AVERROR(ret);
+    }
+    c->prefetch_initialized = 1;
+
+    return 0;
+}
+
+static void prefetch_uninit(AVFormatContext *s)
+{
+    HLSContext *c = s->priv_data;
+
+    if (c->prefetch_thread_created) {
+        pthread_mutex_lock(&c->prefetch_lock);
+        c->prefetch_abort = 1;
+        pthread_cond_signal(&c->prefetch_cond);
+        pthread_mutex_unlock(&c->prefetch_lock);
+        pthread_join(c->prefetch_thread, NULL);
+        c->prefetch_thread_created = 0;
+    }
+}
+#endif /* HAVE_THREADS */
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1482,6 +2318,17 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     int segment_retries = 0;
     struct segment *seg;
 
+#if HAVE_THREADS
+    if (c->prefetch_initialized && !v->prefetch.disabled) {
+        /* the keys of SAMPLE-AES segments are needed by the reader */
+        if (!v->prefetch.active && (seg = current_segment(v)) &&
+            seg->key_type == KEY_SAMPLE_AES)
+            v->prefetch.disabled = 1;
+        else
+            return read_data_prefetch(v, buf, buf_size);
+    }
+#endif
+
 restart:
     if (!v->needed)
         return AVERROR_EOF;
@@ -1913,6 +2760,10 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+#if HAVE_THREADS
+    prefetch_uninit(s);
+#endif
+
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -1923,6 +2774,15 @@ static int hls_close(AVFormatContext *s)
     av_dict_free(&c->avio_opts);
     ff_format_io_close(c->ctx, &c->playlist_pb);
 
+#if HAVE_THREADS
+    if (c->prefetch_initialized) {
+        pthread_cond_destroy(&c->prefetch_data_cond);
+        pthread_cond_destroy(&c->prefetch_cond);
+        pthread_mutex_destroy(&c->prefetch_lock);
+        c->prefetch_initialized = 0;
+    }
+#endif
+
     return 0;
 }
 
@@ -1947,6 +2807,16 @@ static int hls_read_header(AVFormatContext *s)
        the range header */
     av_dict_set_int(&c->avio_opts, "seekable", c->http_seekable, 0);
 
+    if (c->prefetch_segments > 0) {
+#if HAVE_THREADS
+        if ((ret = prefetch_init(s)) < 0)
+            return ret;
+#else
+        av_log(s, AV_LOG_WARNING, "Segment prefetching requires threads, disabled\n");
+        c->prefetch_segments = 0;
+#endif
+    }
+
     if ((ret = parse_playlist(c, s->url, NULL, s->pb)) < 0)
         return ret;
 
@@ -2220,6 +3090,9 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             continue;
         }
         if (cur_needed && !pls->needed) {
+#if HAVE_THREADS
+            prefetch_stop(c, pls);
+#endif
             pls->needed = 1;
             changed = 1;
             pls->cur_seq_no = select_cur_seq_no(c, pls);
@@ -2232,6 +3105,9 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+#if HAVE_THREADS
+            prefetch_stop(c, pls);
+#endif
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2488,6 +3364,9 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         AVIOContext *const pb = &pls->pb.pub;
+#if HAVE_THREADS
+        prefetch_stop(c, pls);
+#endif
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2584,6 +3463,8 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead on a background thread, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
     {NULL}
 };
 
@@ -72,6 +72,11 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -88,6 +93,16 @@ typedef struct HLSSegment {
 
     struct HLSSegment *next;
     double discont_program_date_time;
+
+    int entry_len;      /* length of the cached playlist lines of the segment */
+    int key_len;        /* of which the leading #EXT-X-KEY line */
+    int head_len;       /* of which the tags before the partial segments */
+    int sub_entry_len;  /* length of the cached subtitle playlist lines */
+
+    /* LL-HLS partial segments */
+    char *part_url;
+    HLSPart *parts;
+    int nb_parts;
 } HLSSegment;
 
 typedef enum HLSFlags {
@@ -107,6 +122,7 @@ typedef enum HLSFlags {
     HLS_PERIODIC_REKEY = (1 << 12),
     HLS_INDEPENDENT_SEGMENTS = (1 << 13),
     HLS_I_FRAMES_ONLY = (1 << 14),
+    HLS_INCREMENTAL_PLAYLIST = (1 << 15),
 } HLSFlags;
 
 typedef enum {
@@ -114,6 +130,17 @@ typedef enum {
     SEGMENT_TYPE_FMP4,
 } SegmentType;
 
+/**
+ * Playlist lines of the segments in the window, formatted once per segment.
+ */
+typedef struct EntryCache {
+    uint8_t *buf;
+    unsigned int size;
+    size_t start;   // lines of the first segment in the window
+    size_t end;
+    size_t written; // end of the lines already in the playlist file
+} EntryCache;
+
 typedef struct VariantStream {
     unsigned var_stream_idx;
     unsigned number;
@@ -152,6 +179,28 @@ typedef struct VariantStream {
     HLSSegment *last_segment;
     HLSSegment *old_segments;
 
+    EntryCache entries;
+    EntryCache sub_entries;
+    AVIOContext *entry_pb;          // scratch buffer for formatting entries
+    HLSSegment *cache_tail;         // last segment in the entry caches
+    double cache_prog_date_time;    // program date time after cache_tail
+    int cache_target_duration;      // largest duration of the cached segments
+    int m3u8_appendable;            // new entries can be appended to the playlist file
+    int m3u8_target_duration;       // header values of the playlist file
+    int64_t m3u8_sequence;
+
+    /* LL-HLS partial segments of the current segment */
+    AVIOContext *part_out;
+    char *part_url;                 // segment file name the part names derive from
+    HLSPart *parts;
+    unsigned int parts_size;
+    int nb_parts;
+    int part_pos;                   // start of the current part in the segment buffer
+    int64_t part_start_dts;
+    int part_independent;
+    HLSSegment *parts_head;         // first segment whose parts are listed
+    double parts_duration;          // duration from parts_head to the last segment
+
     char *basename_tmp;
     char *basename;
     char *vtt_basename;
@@ -197,6 +246,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
     uint32_t flags;        // enum HLSFlags
@@ -560,6 +610,7 @@ static int flush_dynbuf(VariantStream *vs, int *range_length)
     avio_flush(vs->out);
 
     // re-open buffer
+    vs->part_pos = 0;
     return avio_open_dyn_buf(&ctx->pb);
 }
 
@@ -575,6 +626,27 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
 #define SEPARATOR '/'
 #endif
 
+/**
+ * Name partial segment idx of the segment url as url.part<idx>.ext
+ */
+static void part_filename(char *buf, int size, const char *url, int idx)
+{
+    const char *ext = strrchr(url, '.');
+    int len;
+
+    if (ext && (strchr(ext, '/') || strchr(ext, SEPARATOR)))
+        ext = NULL;
+    len = ext ? ext - url : strlen(url);
+    snprintf(buf, size, "%.*s.part%d%s", len, url, idx, ext ? ext : "");
+}
+
+static void free_segment(HLSSegment *en)
+{
+    av_freep(&en->part_url);
+    av_freep(&en->parts);
+    av_free(en);
+}
+
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            char *path, const char *proto)
 {
@@ -605,8 +677,9 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
 
     HLSSegment *segment, *previous_segment = NULL;
     float playlist_duration = 0.0f;
-    int ret = 0;
+    int ret = 0, i;
     int segment_cnt = 0;
+    char part[MAX_URL_SIZE];
     AVBPrint path;
     const char *dirname = NULL;
     char *dirname_r = NULL;
@@ -679,6 +752,12 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         if (ret = hls_delete_file(hls, s, path.str, proto))
             goto fail;
 
+        for (i = 0; i < segment->nb_parts; i++) {
+            part_filename(part, sizeof(part), segment->part_url, i);
+            if (ret = hls_delete_file(hls, s, part, proto))
+                goto fail;
+        }
+
         if ((segment->sub_filename[0] != '\0')) {
             vtt_dirname_r = av_strdup(vs->vtt_avf->url);
             vtt_dirname = av_dirname(vtt_dirname_r);
@@ -699,7 +778,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
-        av_freep(&previous_segment);
+        free_segment(previous_segment);
     }
 
 fail:
@@ -1105,6 +1184,170 @@ static int sls_flag_use_localtime_filename(AVFormatContext *oc, HLSContext *c, V
     return 0;
 }
 
+static void write_key_line(AVIOContext *pb, const HLSSegment *en)
+{
+    avio_printf(pb, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
+    if (*en->iv_string)
+        avio_printf(pb, ",IV=0x%s", en->iv_string);
+    avio_printf(pb, "\n");
+}
+
+static void reset_entry_cache(VariantStream *vs)
+{
+    vs->entries.start = vs->entries.end = vs->entries.written = 0;
+    vs->sub_entries.start = vs->sub_entries.end = vs->sub_entries.written = 0;
+    vs->cache_tail = NULL;
+    vs->m3u8_appendable = 0;
+}
+
+static int entry_cache_add(EntryCache *c, const uint8_t *data, int len)
+{
+    uint8_t *buf;
+
+    /* drop the lines of the segments which left the window once they take
+     * up half of the buffer, so the copying stays linear */
+    if (c->start && c->start >= c->end - c->start) {
+        memmove(c->buf, c->buf + c->start, c->end - c->start);
+        c->end    -= c->start;
+        c->written = FFMAX(c->written, c->start) - c->start;
+        c->start   = 0;
+    }
+
+    buf = av_fast_realloc(c->buf, &c->size, c->end + len);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    c->buf = buf;
+    memcpy(c->buf + c->end, data, len);
+    c->end += len;
+
+    return 0;
+}
+
+static int cache_segment_entry(AVFormatContext *s, VariantStream *vs, HLSSegment *en)
+{
+    HLSContext *hls = s->priv_data;
+    const HLSSegment *prev = vs->cache_tail;
+    double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &vs->cache_prog_date_time : NULL;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    uint8_t *buf;
+    int ret, len;
+
+    if (!vs->entry_pb && (ret = avio_open_dyn_buf(&vs->entry_pb)) < 0)
+        return ret;
+
+    /* the key line of the first segment in the window is always written
+     * separately, key_len allows skipping the cached one */
+    if ((hls->encrypt || hls->key_info_file) &&
+        (!prev || strcmp(en->key_uri, prev->key_uri) || av_strcasecmp(en->iv_string, prev->iv_string)))
+        write_key_line(vs->entry_pb, en);
+    en->key_len = avio_tell(vs->entry_pb);
+    if (en->discont)
+        avio_printf(vs->entry_pb, "#EXT-X-DISCONTINUITY\n");
+    en->head_len = avio_tell(vs->entry_pb);
+
+    ret = ff_hls_write_file_entry(vs->entry_pb, 0, byterange_mode,
+                                  en->duration, hls->flags & HLS_ROUND_DURATIONS,
+                                  en->size, en->pos, hls->baseurl,
+                                  en->filename,
+                                  en->discont_program_date_time ? &en->discont_program_date_time : prog_date_time_p,
+                                  en->keyframe_size, en->keyframe_pos, hls->flags & HLS_I_FRAMES_ONLY);
+    if (en->discont_program_date_time)
+        en->discont_program_date_time -= en->duration;
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
+    }
+
+    len = avio_get_dyn_buf(vs->entry_pb, &buf);
+    ret = vs->entry_pb->error;
+    if (ret >= 0)
+        ret = entry_cache_add(&vs->entries, buf, len);
+    ffio_reset_dyn_buf(vs->entry_pb);
+    if (ret < 0)
+        return ret;
+    en->entry_len = len;
+
+    if (vs->vtt_m3u8_name) {
+        ret = ff_hls_write_file_entry(vs->entry_pb, 0, byterange_mode,
+                                      en->duration, 0, en->size, en->pos,
+                                      hls->baseurl, en->sub_filename, NULL, 0, 0, 0);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
+        }
+
+        len = avio_get_dyn_buf(vs->entry_pb, &buf);
+        ret = vs->entry_pb->error;
+        if (ret >= 0)
+            ret = entry_cache_add(&vs->sub_entries, buf, len);
+        ffio_reset_dyn_buf(vs->entry_pb);
+        if (ret < 0)
+            return ret;
+    }
+    en->sub_entry_len = vs->vtt_m3u8_name ? len : 0;
+
+    if (vs->cache_target_duration <= en->duration)
+        vs->cache_target_duration = lrint(en->duration);
+    vs->cache_tail = en;
+
+    return 0;
+}
+
+/**
+ * Format the playlist lines of all segments added since the last call.
+ */
+static int cache_segment_entries(AVFormatContext *s, VariantStream *vs)
+{
+    HLSSegment *en;
+    int ret;
+
+    if (!vs->cache_tail) {
+        reset_entry_cache(vs);
+        vs->cache_prog_date_time  = vs->initial_prog_date_time;
+        vs->cache_target_duration = 0;
+    }
+
+    for (en = vs->cache_tail ? vs->cache_tail->next : vs->segments; en; en = en->next) {
+        ret = cache_segment_entry(s, vs, en);
+        if (ret < 0) {
+            reset_entry_cache(vs);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Remove the lines of the first segment of the window, which is about to be
+ * dropped, from the caches.
+ */
+static void uncache_segment_entry(HLSContext *hls, VariantStream *vs, const HLSSegment *en)
+{
+    const HLSSegment *seg;
+
+    if (!vs->cache_tail)
+        return;
+
+    /* the program date time of the next segments starts from the one of
+     * the window, which does not advance past the dropped segment here */
+    if (en == vs->cache_tail ||
+        ((hls->flags & HLS_PROGRAM_DATE_TIME) &&
+         !en->discont_program_date_time && en->next->discont_program_date_time)) {
+        reset_entry_cache(vs);
+        return;
+    }
+
+    vs->entries.start     += en->entry_len;
+    vs->sub_entries.start += en->sub_entry_len;
+
+    vs->cache_target_duration = 0;
+    for (seg = en->next; seg; seg = seg->next) {
+        if (vs->cache_target_duration <= seg->duration)
+            vs->cache_target_duration = lrint(seg->duration);
+        if (seg == vs->cache_tail)
+            break;
+    }
+}
+
 /* Create a new segment and append it to the segment list */
 static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
                               VariantStream *vs, double duration, int64_t pos,
@@ -1149,6 +1392,9 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->next     = NULL;
     en->discont  = 0;
     en->discont_program_date_time = 0;
+    en->part_url = NULL;
+    en->parts    = NULL;
+    en->nb_parts = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1160,6 +1406,20 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
         av_strlcpy(en->iv_string, vs->iv_string, sizeof(en->iv_string));
     }
 
+    if (hls->part_time) {
+        if (vs->nb_parts) {
+            en->parts = av_memdup(vs->parts, vs->nb_parts * sizeof(*vs->parts));
+            if (!en->parts) {
+                av_freep(&en);
+                return AVERROR(ENOMEM);
+            }
+        }
+        en->nb_parts = vs->nb_parts;
+        en->part_url = vs->part_url;
+        vs->part_url = NULL;
+        vs->nb_parts = 0;
+    }
+
     if (!vs->segments)
         vs->segments = en;
     else
@@ -1167,12 +1427,23 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
 
     vs->last_segment = en;
 
+    if (hls->part_time) {
+        if (!vs->parts_head)
+            vs->parts_head = en;
+        vs->parts_duration += en->duration;
+    }
+
     // EVENT or VOD playlists imply sliding window cannot be used
     if (hls->pl_type != PLAYLIST_TYPE_NONE)
         hls->max_nb_segments = 0;
 
     if (hls->max_nb_segments && vs->nb_entries >= hls->max_nb_segments) {
         en = vs->segments;
+        uncache_segment_entry(hls, vs, en);
+        if (en == vs->parts_head) {
+            vs->parts_head      = en->next;
+            vs->parts_duration -= en->duration;
+        }
         if (!en->next->discont_program_date_time && !en->discont_program_date_time)
             vs->initial_prog_date_time += en->duration;
         vs->segments = en->next;
@@ -1183,7 +1454,7 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
         } else
-            av_freep(&en);
+            free_segment(en);
     } else
         vs->nb_entries++;
 
@@ -1315,7 +1586,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
-        av_freep(&en);
+        free_segment(en);
     }
 }
 
@@ -1543,6 +1814,126 @@ fail:
     return ret;
 }
 
+static int append_entries(AVFormatContext *s, AVIOContext **pb, char *filename,
+                          EntryCache *c, int end_list)
+{
+    AVDictionary *options = NULL;
+    int64_t size;
+    int ret;
+
+    av_dict_set(&options, "truncate", "0", 0);
+    ret = hlsenc_io_open(s, pb, filename, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+
+    size = avio_size(*pb);
+    ret = size < 0 ? size : avio_seek(*pb, size, SEEK_SET);
+    if (ret >= 0) {
+        avio_write(*pb, c->buf + c->written, c->end - c->written);
+        if (end_list)
+            ff_hls_write_end_list(*pb);
+        avio_flush(*pb);
+        ret = (*pb)->error;
+        c->written = c->end;
+    }
+    hlsenc_io_close(s, pb, filename);
+
+    return ret;
+}
+
+/**
+ * Append the entries of the segments added since the last update to the
+ * playlist files, for playlists that only grow.
+ */
+static int hls_append_window(AVFormatContext *s, int last, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int ret;
+
+    vs->m3u8_appendable = 0;
+
+    ret = append_entries(s, byterange_mode ? &hls->m3u8_out : &vs->out, vs->m3u8_name,
+                         &vs->entries, last && !(hls->flags & HLS_OMIT_ENDLIST));
+    if (ret >= 0 && vs->vtt_m3u8_name)
+        ret = append_entries(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name,
+                             &vs->sub_entries, last);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Failed to append to playlist '%s'\n", vs->m3u8_name);
+        return hls->ignore_io_errors ? 0 : ret;
+    }
+
+    vs->m3u8_appendable = !last;
+    if (hls->master_pl_name)
+        if (create_master_playlist(s, vs) < 0)
+            av_log(s, AV_LOG_WARNING, "Master playlist creation failed\n");
+
+    return 0;
+}
+
+static void write_parts(AVIOContext *pb, HLSContext *hls, const char *url,
+                        const HLSPart *parts, int nb_parts)
+{
+    char filename[MAX_URL_SIZE];
+
+    if (!hls->use_localtime_mkdir)
+        url = av_basename(url);
+
+    for (int i = 0; i < nb_parts; i++) {
+        part_filename(filename, sizeof(filename), url, i);
+        avio_printf(pb, "#EXT-X-PART:DURATION=%f,URI=\"%s%s\"%s\n", parts[i].duration,
+                    hls->baseurl ? hls->baseurl : "", filename,
+                    parts[i].independent ? ",INDEPENDENT=YES" : "");
+    }
+}
+
+/**
+ * Write the cached lines of the segments in the window, with the partial
+ * segments of the last ones and of the current segment in LL-HLS mode.
+ */
+static void write_window_entries(AVIOContext *pb, HLSContext *hls, VariantStream *vs, int last)
+{
+    const EntryCache *c = &vs->entries;
+    const HLSSegment *en;
+    size_t pos = c->start, end = c->end;
+    char filename[MAX_URL_SIZE];
+
+    /* the key line of the first segment is written separately */
+    if (vs->segments)
+        pos += vs->segments->key_len;
+
+    for (en = vs->parts_head; en; en = en->next)
+        end -= en->entry_len;
+    if (end > pos) {
+        avio_write(pb, c->buf + pos, end - pos);
+        pos = end;
+    }
+
+    for (en = vs->parts_head; en; en = en->next) {
+        if (end + en->head_len > pos) {
+            avio_write(pb, c->buf + pos, end + en->head_len - pos);
+            pos = end + en->head_len;
+        }
+        write_parts(pb, hls, en->part_url, en->parts, en->nb_parts);
+        end += en->entry_len;
+        avio_write(pb, c->buf + pos, end - pos);
+        pos = end;
+    }
+
+    if (!hls->part_time || last || !vs->part_url)
+        return;
+
+    if (vs->discontinuity)
+        avio_printf(pb, "#EXT-X-DISCONTINUITY\n");
+    write_parts(pb, hls, vs->part_url, vs->parts, vs->nb_parts);
+    part_filename(filename, sizeof(filename),
+                  hls->use_localtime_mkdir ? vs->part_url : av_basename(vs->part_url),
+                  vs->nb_parts);
+    avio_printf(pb, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%s\"\n",
+                hls->baseurl ? hls->baseurl : "", filename);
+}
+
 static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
@@ -1556,12 +1947,9 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     int is_file_proto = proto && !strcmp(proto, "file");
     int use_temp_file = is_file_proto && ((hls->flags & HLS_TEMP_FILE) || !(hls->pl_type == PLAYLIST_TYPE_VOD));
     static unsigned warned_non_file;
-    char *key_uri = NULL;
-    char *iv_string = NULL;
     AVDictionary *options = NULL;
-    double prog_date_time = vs->initial_prog_date_time;
-    double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int complete = 0;
 
     hls->version = 2;
     if (!(hls->flags & HLS_ROUND_DURATIONS)) {
@@ -1588,6 +1976,26 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (!is_file_proto && (hls->flags & HLS_TEMP_FILE) && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporary partial files\n");
 
+    ret = cache_segment_entries(s, vs);
+    if (ret < 0)
+        return ret;
+    target_duration = vs->cache_target_duration;
+
+    if (hls->part_time) {
+        /* partial segments are only listed for the last three target
+         * durations, and the first playlists only have partial segments */
+        target_duration = FFMAX(target_duration, lrint(hls->time / (double)AV_TIME_BASE));
+        while (vs->parts_head && vs->parts_duration - vs->parts_head->duration >= 3 * target_duration) {
+            vs->parts_duration -= vs->parts_head->duration;
+            vs->parts_head      = vs->parts_head->next;
+        }
+    }
+
+    if (vs->m3u8_appendable && target_duration <= vs->m3u8_target_duration &&
+        sequence == vs->m3u8_sequence)
+        return hls_append_window(s, last, vs);
+    vs->m3u8_appendable = 0;
+
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
     ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options);
@@ -1598,14 +2006,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         goto fail;
     }
 
-    for (en = vs->segments; en; en = en->next) {
-        if (target_duration <= en->duration)
-            target_duration = lrint(en->duration);
-    }
-
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
+    if (hls->part_time) {
+        double part_target = hls->part_time / (double)AV_TIME_BASE;
+
+        avio_printf(byterange_mode ? hls->m3u8_out : vs->out,
+                    "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%f\n", 3 * part_target);
+        avio_printf(byterange_mode ? hls->m3u8_out : vs->out,
+                    "#EXT-X-PART-INF:PART-TARGET=%f\n", part_target);
+    }
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
@@ -1614,35 +2025,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
-    for (en = vs->segments; en; en = en->next) {
-        if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
-                                    av_strcasecmp(en->iv_string, iv_string))) {
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
-            if (*en->iv_string)
-                avio_printf(byterange_mode ? hls->m3u8_out : vs->out, ",IV=0x%s", en->iv_string);
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "\n");
-            key_uri = en->key_uri;
-            iv_string = en->iv_string;
-        }
-
-        if ((hls->segment_type == SEGMENT_TYPE_FMP4) && (en == vs->segments)) {
-            ff_hls_write_init_file(byterange_mode ? hls->m3u8_out : vs->out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
-                                   hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
-        }
-
-        ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
-                                      en->duration, hls->flags & HLS_ROUND_DURATIONS,
-                                      en->size, en->pos, hls->baseurl,
-                                      en->filename,
-                                      en->discont_program_date_time ? &en->discont_program_date_time : prog_date_time_p,
-                                      en->keyframe_size, en->keyframe_pos, hls->flags & HLS_I_FRAMES_ONLY);
-        if (en->discont_program_date_time)
-            en->discont_program_date_time -= en->duration;
-        if (ret < 0) {
-            av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
-        }
+    en = vs->segments;
+    if (en && (hls->encrypt || hls->key_info_file))
+        write_key_line(byterange_mode ? hls->m3u8_out : vs->out, en);
+
+    if ((en || hls->part_time) && hls->segment_type == SEGMENT_TYPE_FMP4) {
+        ff_hls_write_init_file(byterange_mode ? hls->m3u8_out : vs->out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
+                               hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
     }
 
+    write_window_entries(byterange_mode ? hls->m3u8_out : vs->out, hls, vs, last);
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -1658,19 +2051,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
         ff_hls_write_playlist_header(hls->sub_m3u8_out, hls->version, hls->allowcache,
                                      target_duration, sequence, PLAYLIST_TYPE_NONE, 0);
-        for (en = vs->segments; en; en = en->next) {
-            ret = ff_hls_write_file_entry(hls->sub_m3u8_out, 0, byterange_mode,
-                                          en->duration, 0, en->size, en->pos,
-                                          hls->baseurl, en->sub_filename, NULL, 0, 0, 0);
-            if (ret < 0) {
-                av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
-            }
-        }
+        avio_write(hls->sub_m3u8_out, vs->sub_entries.buf + vs->sub_entries.start,
+                   vs->sub_entries.end - vs->sub_entries.start);
 
         if (last)
             ff_hls_write_end_list(hls->sub_m3u8_out);
 
+        complete = !hls->sub_m3u8_out->error;
+    } else {
+        complete = 1;
     }
+    complete &= !(byterange_mode ? hls->m3u8_out : vs->out)->error;
 
 fail:
     av_dict_free(&options);
@@ -1679,6 +2070,16 @@ fail:
         return ret;
     }
     hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+
+    /* a playlist which keeps all segments only grows from now on */
+    if (complete && !last && (hls->flags & HLS_INCREMENTAL_PLAYLIST) &&
+        is_file_proto && !hls->max_nb_segments && !hls->part_time) {
+        vs->m3u8_appendable      = 1;
+        vs->m3u8_target_duration = target_duration;
+        vs->m3u8_sequence        = sequence;
+        vs->entries.written      = vs->entries.end;
+        vs->sub_entries.written  = vs->sub_entries.end;
+    }
     if (use_temp_file) {
         ff_rename(temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
@@ -1774,6 +2175,13 @@ static int hls_start(AVFormatContext *s, VariantStream *vs)
        }
     }
 
+    if (c->part_time) {
+        av_free(vs->part_url);
+        vs->part_url = av_strdup(oc->url);
+        if (!vs->part_url)
+            return AVERROR(ENOMEM);
+    }
+
     proto = avio_find_protocol_name(oc->url);
     use_temp_file = proto && !strcmp(proto, "file") && (c->flags & HLS_TEMP_FILE);
 
@@ -2418,6 +2826,109 @@ static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 
     return ret;
 }
+
+static int flush_init_section(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    vs->part_pos = 0;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+
+    return 0;
+}
+
+/**
+ * Write the data muxed since the last partial segment as the next partial
+ * segment of the current segment.
+ */
+static int hls_write_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    const char *proto = avio_find_protocol_name(vs->part_url);
+    int use_temp_file = proto && !strcmp(proto, "file") && (hls->flags & HLS_TEMP_FILE);
+    char filename[MAX_URL_SIZE];
+    char temp_filename[MAX_URL_SIZE];
+    AVDictionary *options = NULL;
+    HLSPart *parts;
+    uint8_t *buf;
+    int size, ret;
+
+    av_write_frame(oc, NULL); /* Flush the fragment */
+    if (!vs->init_range_length) {
+        /* the first flush only writes the moov, the fragment follows */
+        ret = flush_init_section(s, vs);
+        if (ret < 0)
+            return ret;
+        av_write_frame(oc, NULL);
+    }
+
+    size = avio_get_dyn_buf(oc->pb, &buf);
+    if (size <= vs->part_pos)
+        return 0;
+
+    parts = av_fast_realloc(vs->parts, &vs->parts_size, (vs->nb_parts + 1) * sizeof(*vs->parts));
+    if (!parts)
+        return AVERROR(ENOMEM);
+    vs->parts = parts;
+
+    part_filename(filename, sizeof(filename), vs->part_url, vs->nb_parts);
+    snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", filename);
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->part_out, temp_filename, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to open file '%s'\n", temp_filename);
+        return hls->ignore_io_errors ? 0 : ret;
+    }
+    avio_write(vs->part_out, buf + vs->part_pos, size - vs->part_pos);
+    ret = hlsenc_io_close(s, &vs->part_out, temp_filename);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Failed to upload file '%s'\n", temp_filename);
+        if (!hls->ignore_io_errors)
+            return ret;
+    }
+    if (use_temp_file)
+        ff_rename(temp_filename, filename, s);
+
+    vs->parts[vs->nb_parts].duration    = duration;
+    vs->parts[vs->nb_parts].independent = vs->part_independent;
+    vs->nb_parts++;
+    vs->part_pos = size;
+
+    return 0;
+}
+
+static int hls_update_window(AVFormatContext *s, VariantStream *vs)
+{
+    int ret;
+
+    if ((ret = hls_window(s, 0, vs)) < 0) {
+        av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
+        ff_format_io_close(s, &vs->out);
+        ret = hls_window(s, 0, vs);
+    }
+
+    return ret;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2520,21 +3031,20 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = flush_init_section(s, vs);
+                if (ret < 0)
+                    return ret;
             }
         }
+        if (hls->part_time) {
+            double cur_duration = (double)(pkt->pts - vs->end_pts) * st->time_base.num / st->time_base.den;
+            for (i = 0; i < vs->nb_parts; i++)
+                cur_duration -= vs->parts[i].duration;
+            ret = hls_write_part(s, vs, cur_duration);
+            if (ret < 0)
+                return ret;
+            vs->part_start_dts = AV_NOPTS_VALUE;
+        }
         if (!byterange_mode) {
             if (vs->vtt_avf) {
                 hlsenc_io_close(s, &vs->vtt_avf->pb, vs->vtt_avf->url);
@@ -2630,14 +3140,11 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
-            if ((ret = hls_window(s, 0, vs)) < 0) {
-                av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
-                ff_format_io_close(s, &vs->out);
-                if ((ret = hls_window(s, 0, vs)) < 0) {
-                    av_freep(&old_filename);
-                    return ret;
-                }
+        // LL-HLS playlists are written once the next segment is started, for the preload hint
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !hls->part_time) {
+            if ((ret = hls_update_window(s, vs)) < 0) {
+                av_freep(&old_filename);
+                return ret;
             }
         }
 
@@ -2678,6 +3185,26 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (ret < 0) {
             return ret;
         }
+
+        if (hls->part_time && (ret = hls_update_window(s, vs)) < 0)
+            return ret;
+    }
+
+    if (hls->part_time && pkt->stream_index == vs->reference_stream_index &&
+        pkt->dts != AV_NOPTS_VALUE) {
+        if (vs->part_start_dts == AV_NOPTS_VALUE) {
+            vs->part_start_dts   = pkt->dts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        } else if (av_compare_ts(pkt->dts + pkt->duration - vs->part_start_dts, st->time_base,
+                                 hls->part_time, AV_TIME_BASE_Q) > 0) {
+            ret = hls_write_part(s, vs, (double)(pkt->dts - vs->part_start_dts) * st->time_base.num / st->time_base.den);
+            if (ret < 0)
+                return ret;
+            if ((ret = hls_update_window(s, vs)) < 0)
+                return ret;
+            vs->part_start_dts   = pkt->dts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        }
     }
 
     vs->packets_written++;
@@ -2717,6 +3244,12 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        av_freep(&vs->entries.buf);
+        av_freep(&vs->sub_entries.buf);
+        ffio_free_dyn_buf(&vs->entry_pb);
+        av_freep(&vs->part_url);
+        av_freep(&vs->parts);
+        ff_format_io_close(s, &vs->part_out);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2787,6 +3320,14 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time) {
+            double duration = vs->duration + vs->dpp;
+            for (int j = 0; j < vs->nb_parts; j++)
+                duration -= vs->parts[j].duration;
+            ret = hls_write_part(s, vs, duration);
+            if (ret < 0)
+                goto failed;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2965,6 +3506,21 @@ static int hls_init(AVFormatContext *s)
                "enabled together. Disabling 'independent_segments' flag\n");
     }
 
+    if (hls->part_time) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires hls_segment_type fmp4\n");
+            return AVERROR(EINVAL);
+        }
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time does not support byte range segments\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->pl_type == PLAYLIST_TYPE_VOD) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time is not supported for VOD playlists\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2975,6 +3531,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_dts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -2988,6 +3545,16 @@ static int hls_init(AVFormatContext *s)
             vs->has_subtitle += vs->streams[j]->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE;
         }
 
+        /* Without video, partial segments are cut on the first other stream. */
+        if (hls->part_time && !vs->has_video) {
+            for (j = 0; j < vs->nb_streams; j++) {
+                if (vs->streams[j]->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE) {
+                    vs->reference_stream_index = vs->streams[j]->index;
+                    break;
+                }
+            }
+        }
+
         if (vs->has_video > 1)
             av_log(s, AV_LOG_WARNING, "More than a single video stream present, expect issues decoding it.\n");
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
@@ -3126,6 +3693,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set the target duration of LL-HLS partial segments", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_vtt_options","set hls vtt list of options for the container format used for hls", OFFSET(vtt_format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
@@ -3161,6 +3729,7 @@ static const AVOption options[] = {
     {"periodic_rekey", "reload keyinfo file periodically for re-keying", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_PERIODIC_REKEY }, 0, UINT_MAX,   E, "flags"},
     {"independent_segments", "add EXT-X-INDEPENDENT-SEGMENTS, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_INDEPENDENT_SEGMENTS }, 0, UINT_MAX, E, "flags"},
     {"iframes_only", "add EXT-X-I-FRAMES-ONLY, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_I_FRAMES_ONLY }, 0, UINT_MAX, E, "flags"},
+    {"incremental_playlist", "append the entries of new segments to playlists that keep all segments", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_INCREMENTAL_PLAYLIST }, 0, UINT_MAX, E, "flags"},
     {"strftime", "set filename expansion with strftime at segment creation", OFFSET(use_localtime), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"strftime_mkdir", "create last directory component in strftime-generated filename", OFFSET(use_localtime_mkdir), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"hls_playlist_type", "set the HLS playlist type", OFFSET(pl_type), AV_OPT_TYPE_INT, {.i64 = PLAYLIST_TYPE_NONE }, 0, PLAYLIST_TYPE_NB-1, E, "pl_type" },
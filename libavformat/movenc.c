@@ -83,6 +83,7 @@ static const AVOption options[] = {
     { "iods_video_profile", "iods video profile atom.", offsetof(MOVMuxContext, iods_video_profile), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 255, AV_OPT_FLAG_ENCODING_PARAM},
     { "ism_lookahead", "Number of lookahead entries for ISM files", offsetof(MOVMuxContext, ism_lookahead), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 255, AV_OPT_FLAG_ENCODING_PARAM},
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+      { "chunked", "Write every fragment to the output as soon as it is complete", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_CHUNKED}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
       { "cmaf", "Write CMAF compatible fragmented MP4", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_CMAF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
       { "dash", "Write DASH compatible fragmented MP4", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DASH}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
       { "default_base_moof", "Set the default-base-is-moof flag in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DEFAULT_BASE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -5205,6 +5206,24 @@ static int mov_write_sidx_tag(AVIOContext *pb,
     return update_size(pb, pos);
 }
 
+/**
+ * Get the null buffer for calculating the size of boxes written for every
+ * fragment, without allocating a new one each time.
+ */
+static int mov_open_size_buf(MOVMuxContext *mov, AVIOContext **pb)
+{
+    int ret;
+
+    if (!mov->size_buf) {
+        if ((ret = ffio_open_null_buf(&mov->size_buf)) < 0)
+            return ret;
+    } else {
+        ffio_reset_dyn_buf(mov->size_buf);
+    }
+    *pb = mov->size_buf;
+    return 0;
+}
+
 static int mov_write_sidx_tags(AVIOContext *pb, MOVMuxContext *mov,
                                int tracks, int ref_size)
 {
@@ -5217,7 +5236,7 @@ static int mov_write_sidx_tags(AVIOContext *pb, MOVMuxContext *mov,
         // This would be much simpler if we'd only write one sidx
         // atom, for the first track in the moof.
         if (round == 0) {
-            if ((ret = ffio_open_null_buf(&avio_buf)) < 0)
+            if ((ret = mov_open_size_buf(mov, &avio_buf)) < 0)
                 return ret;
         } else {
             avio_buf = pb;
@@ -5235,7 +5254,7 @@ static int mov_write_sidx_tags(AVIOContext *pb, MOVMuxContext *mov,
                                              total_size);
         }
         if (round == 0)
-            total_size = ffio_close_null_buf(avio_buf);
+            total_size = avio_tell(avio_buf);
     }
     return 0;
 }
@@ -5296,10 +5315,10 @@ static int mov_write_moof_tag(AVIOContext *pb, MOVMuxContext *mov, int tracks,
     AVIOContext *avio_buf;
     int ret, moof_size;
 
-    if ((ret = ffio_open_null_buf(&avio_buf)) < 0)
+    if ((ret = mov_open_size_buf(mov, &avio_buf)) < 0)
         return ret;
     mov_write_moof_tag_internal(avio_buf, mov, tracks, 0);
-    moof_size = ffio_close_null_buf(avio_buf);
+    moof_size = avio_tell(avio_buf);
 
     if (mov->flags & FF_MOV_FLAG_DASH &&
         !(mov->flags & (FF_MOV_FLAG_GLOBAL_SIDX | FF_MOV_FLAG_SKIP_SIDX)))
@@ -5757,7 +5776,8 @@ static int mov_flush_fragment_interleaving(AVFormatContext *s, MOVTrack *track)
 
     offset = avio_tell(mov->mdat_buf);
     avio_write(mov->mdat_buf, buf, buf_size);
-    ffio_free_dyn_buf(&track->mdat_buf);
+    // Keep the buffer of the track for the next interleaving chunk
+    ffio_reset_dyn_buf(track->mdat_buf);
 
     for (i = track->entries_flushed; i < track->entry; i++)
         track->cluster[i].pos += offset;
@@ -5827,6 +5847,18 @@ static int mov_write_squashed_packets(AVFormatContext *s)
     return 0;
 }
 
+/**
+ * Mark the end of a complete part of the file, which is handed to the
+ * output right away in chunked mode.
+ */
+static void mov_write_flush_point(AVIOContext *pb, MOVMuxContext *mov)
+{
+    if (mov->flags & FF_MOV_FLAG_CHUNKED)
+        avio_flush(pb);
+    else
+        avio_write_marker(pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+}
+
 static int mov_flush_fragment(AVFormatContext *s, int force)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5920,7 +5952,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         if (mov->flags & FF_MOV_FLAG_DELAY_MOOV) {
             if (mov->flags & FF_MOV_FLAG_GLOBAL_SIDX)
                 mov->reserved_header_pos = avio_tell(s->pb);
-            avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+            mov_write_flush_point(s->pb, mov);
             mov->moov_written = 1;
             return 0;
         }
@@ -5940,7 +5972,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
             mov->tracks[i].entry = 0;
             mov->tracks[i].end_reliable = 0;
         }
-        avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+        mov_write_flush_point(s->pb, mov);
         return 0;
     }
 
@@ -5952,9 +5984,8 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
                 return ret;
         }
 
-        if (!mov->mdat_buf)
+        if (!mov->mdat_buf || !(mdat_size = avio_tell(mov->mdat_buf)))
             return 0;
-        mdat_size = avio_tell(mov->mdat_buf);
     }
 
     for (i = 0; i < mov->nb_tracks; i++) {
@@ -6001,7 +6032,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         }
 
         if (write_moof) {
-            avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+            mov_write_flush_point(s->pb, mov);
 
             mov_write_moof_tag(s->pb, mov, moof_tracks, mdat_size);
             mov->fragments++;
@@ -6016,22 +6047,23 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         if (!mov->frag_interleave) {
             if (!track->mdat_buf)
                 continue;
-            buf_size = avio_close_dyn_buf(track->mdat_buf, &buf);
-            track->mdat_buf = NULL;
+            // Keep the buffer of the track for the next fragment
+            buf_size = avio_get_dyn_buf(track->mdat_buf, &buf);
+            avio_write(s->pb, buf, buf_size);
+            ffio_reset_dyn_buf(track->mdat_buf);
         } else {
             if (!mov->mdat_buf)
                 continue;
-            buf_size = avio_close_dyn_buf(mov->mdat_buf, &buf);
-            mov->mdat_buf = NULL;
+            // Keep the interleaved buffer for the next fragment as well
+            buf_size = avio_get_dyn_buf(mov->mdat_buf, &buf);
+            avio_write(s->pb, buf, buf_size);
+            ffio_reset_dyn_buf(mov->mdat_buf);
         }
-
-        avio_write(s->pb, buf, buf_size);
-        av_free(buf);
     }
 
     mov->mdat_size = 0;
 
-    avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+    mov_write_flush_point(s->pb, mov);
     return 0;
 }
 
@@ -6896,6 +6928,7 @@ static void mov_free(AVFormatContext *s)
 
     av_freep(&mov->tracks);
     ffio_free_dyn_buf(&mov->mdat_buf);
+    ffio_free_dyn_buf(&mov->size_buf);
 }
 
 static uint32_t rgb_to_yuv(uint32_t rgb)
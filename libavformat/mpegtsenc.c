@@ -93,6 +93,8 @@ typedef struct MpegTSWrite {
     int mux_rate; ///< set to 1 when VBR
     int pes_payload_size;
     int64_t total_size;
+    uint8_t *pes_packets; ///< TS packets of the PES being written in VBR mode
+    unsigned int pes_packets_size;
 
     int transport_stream_id;
     int original_network_id;
@@ -1469,6 +1471,80 @@ static int get_pes_stream_id(AVFormatContext *s, AVStream *st, int stream_id, in
     }
 }
 
+/* Check if retransmit_si_info() would write any table for this PCR. */
+static int si_info_due(const MpegTSWrite *ts, int64_t pcr)
+{
+    if (pcr == AV_NOPTS_VALUE)
+        return 0;
+    return ts->last_sdt_ts == AV_NOPTS_VALUE || pcr - ts->last_sdt_ts >= ts->sdt_period ||
+           ts->last_pat_ts == AV_NOPTS_VALUE || pcr - ts->last_pat_ts >= ts->pat_period ||
+           ts->last_nit_ts == AV_NOPTS_VALUE || pcr - ts->last_nit_ts >= ts->nit_period;
+}
+
+/* Write the rest of a PES in VBR mode. Apart from the continuity counter,
+ * these TS packets only differ in their payload, so they are built from one
+ * header into a contiguous buffer, and output with a single write as long as
+ * no SI tables have to be inserted.
+ * Returns the number of payload bytes written, 0 if the caller has to write
+ * the packets one by one. */
+static int mpegts_write_pes_payload(AVFormatContext *s, AVStream *st,
+                                    const uint8_t *payload, int payload_size,
+                                    int64_t pcr, int is_dvb_subtitle)
+{
+    MpegTSWriteStream *ts_st = st->priv_data;
+    MpegTSWrite *ts = s->priv_data;
+    int nb_packets = (payload_size + TS_PACKET_SIZE - 5) / (TS_PACKET_SIZE - 4);
+    int written = payload_size;
+    uint8_t *q;
+
+    av_fast_malloc(&ts->pes_packets, &ts->pes_packets_size, nb_packets * TS_PACKET_SIZE);
+    if (!ts->pes_packets)
+        return 0;
+
+    q = ts->pes_packets;
+    while (payload_size > 0) {
+        int len = FFMIN(payload_size, TS_PACKET_SIZE - 4);
+        int stuffing_len = TS_PACKET_SIZE - 4 - len;
+
+        if (si_info_due(ts, pcr)) {
+            avio_write(s->pb, ts->pes_packets, q - ts->pes_packets);
+            ts->total_size += q - ts->pes_packets;
+            q = ts->pes_packets;
+            retransmit_si_info(s, 0, 0, 0, pcr);
+        }
+
+        ts_st->cc = ts_st->cc + 1 & 0xf;
+        q[0] = 0x47;
+        q[1] = ts_st->pid >> 8;
+        q[2] = ts_st->pid;
+        q[3] = 0x10 | ts_st->cc; // payload indicator + CC
+        if (stuffing_len > 0) {
+            /* add stuffing with AFC */
+            q[3] |= 0x20;
+            q[4]  = stuffing_len - 1;
+            if (stuffing_len >= 2) {
+                q[5] = 0x00;
+                memset(q + 6, 0xff, stuffing_len - 2);
+            }
+        }
+
+        if (is_dvb_subtitle && payload_size == len) {
+            memcpy(q + TS_PACKET_SIZE - len, payload, len - 1);
+            q[TS_PACKET_SIZE - 1] = 0xff; /* end_of_PES_data_field_marker */
+        } else {
+            memcpy(q + TS_PACKET_SIZE - len, payload, len);
+        }
+
+        payload      += len;
+        payload_size -= len;
+        q            += TS_PACKET_SIZE;
+    }
+    avio_write(s->pb, ts->pes_packets, q - ts->pes_packets);
+    ts->total_size += q - ts->pes_packets;
+
+    return written;
+}
+
 /* Add a PES header to the front of the payload, and segment into an integer
  * number of TS packets. The final TS packet is padded using an oversized
  * adaptation header to exactly fill the last TS packet.
@@ -1510,6 +1586,16 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         else if (dts != AV_NOPTS_VALUE)
             pcr = (dts - delay) * 300;
 
+        /* In VBR mode, only the first packet of a PES can carry a PCR or
+         * any other adaptation field flags. */
+        if (!is_start && ts->mux_rate <= 1 && !ts->m2ts_mode && !ts_st->discontinuity) {
+            len = mpegts_write_pes_payload(s, st, payload, payload_size, pcr, is_dvb_subtitle);
+            payload      += len;
+            payload_size -= len;
+            if (!payload_size)
+                break;
+        }
+
         retransmit_si_info(s, force_pat, force_sdt, force_nit, pcr);
         force_pat = 0;
         force_sdt = 0;
@@ -2252,6 +2338,7 @@ static void mpegts_deinit(AVFormatContext *s)
         av_freep(&service);
     }
     av_freep(&ts->services);
+    av_freep(&ts->pes_packets);
 }
 
 static int mpegts_check_bitstream(AVFormatContext *s, AVStream *st,
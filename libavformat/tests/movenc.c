@@ -355,7 +355,7 @@ static void help(void)
 
 int main(int argc, char **argv)
 {
-    int c;
+    int c, i;
     uint8_t header[HASH_SIZE];
     uint8_t content[HASH_SIZE];
     int empty_moov_pos;
@@ -742,6 +742,21 @@ int main(int argc, char **argv)
     close_out();
     force_iobuf_size = 0;
 
+    // Test that in chunked mode every fragment is written out as soon as
+    // it is complete, even if the IO context asks for larger packets.
+    init_out("chunked");
+    av_dict_set(&opts, "movflags", "+frag_custom+empty_moov+chunked", 0);
+    init(0, 0);
+    ctx->pb->min_packet_size = sizeof(iobuf);
+    for (i = 0; i < 3; i++) {
+        prev_pos = out_size;
+        mux_frames(gop_size / 3, 0);
+        av_write_frame(ctx, NULL);
+        check(out_size > prev_pos, "Fragment %d not written out", i);
+    }
+    finish();
+    close_out();
+
     // Test VFR content with bframes with interleaving.
     // Here, using av_interleaved_write_frame allows the muxer to get the
     // fragment end durations right. We always set the packet duration to
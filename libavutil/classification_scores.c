@@ -0,0 +1,72 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "classification_scores.h"
+#include "mem.h"
+
+AVClassificationScores *av_classification_scores_alloc(uint32_t nb_scores, size_t *out_size)
+{
+    size_t size;
+    struct ScoresContext {
+        AVClassificationScores header;
+        float scores;
+    };
+    const size_t scores_offset = offsetof(struct ScoresContext, scores);
+    AVClassificationScores *header;
+
+    size = scores_offset;
+    if (nb_scores > (SIZE_MAX - size) / sizeof(float))
+        return NULL;
+    size += sizeof(float) * nb_scores;
+
+    header = av_mallocz(size);
+    if (!header)
+        return NULL;
+
+    header->top_class     = -1;
+    header->nb_scores     = nb_scores;
+    header->scores_offset = scores_offset;
+
+    if (out_size)
+        *out_size = size;
+
+    return header;
+}
+
+AVClassificationScores *av_classification_scores_create_side_data(AVFrame *frame, uint32_t nb_scores)
+{
+    AVBufferRef *buf;
+    AVClassificationScores *header;
+    size_t size;
+
+    header = av_classification_scores_alloc(nb_scores, &size);
+    if (!header)
+        return NULL;
+    buf = av_buffer_create((uint8_t *)header, size, NULL, NULL, 0);
+    if (!buf) {
+        av_freep(&header);
+        return NULL;
+    }
+
+    if (!av_frame_new_side_data_from_buf(frame, AV_FRAME_DATA_CLASSIFICATION_SCORES, buf)) {
+        av_buffer_unref(&buf);
+        return NULL;
+    }
+
+    return header;
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_CLASSIFICATION_SCORES_H
+#define AVUTIL_CLASSIFICATION_SCORES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+
+#define AV_CLASSIFICATION_MODEL_ID_SIZE 64
+
+/**
+ * Per-class scores of a whole-frame classification, stored as
+ * AVFrameSideData of type AV_FRAME_DATA_CLASSIFICATION_SCORES.
+ *
+ * sizeof(AVClassificationScores) is not a part of the ABI, allocate it
+ * with av_classification_scores_alloc() or
+ * av_classification_scores_create_side_data().
+ */
+typedef struct AVClassificationScores {
+    /**
+     * Identifier of the model that computed the scores, e.g. its file name.
+     * Must end with a null terminator.
+     */
+    char model_id[AV_CLASSIFICATION_MODEL_ID_SIZE];
+
+    /**
+     * Index of the class with the highest score, -1 if there is none.
+     */
+    int top_class;
+
+    /**
+     * Number of scores in the array, one per class of the model.
+     */
+    uint32_t nb_scores;
+
+    /**
+     * Offset in bytes from the beginning of this structure at which
+     * the array of float scores starts.
+     */
+    size_t scores_offset;
+} AVClassificationScores;
+
+/**
+ * Get the array of {@code nb_scores} scores.
+ */
+static av_always_inline float *
+av_classification_scores_get(const AVClassificationScores *scores)
+{
+    return (float *)((uint8_t *)scores + scores->scores_offset);
+}
+
+/**
+ * Allocates memory for AVClassificationScores, plus an array of
+ * {@code nb_scores} floats, and initializes the variables.
+ * Can be freed with a normal av_free() call.
+ *
+ * @param nb_scores number of scores to allocate
+ * @param out_size if non-NULL, the size in bytes of the resulting data array is
+ * written here.
+ */
+AVClassificationScores *av_classification_scores_alloc(uint32_t nb_scores, size_t *out_size);
+
+/**
+ * Allocates memory for AVClassificationScores, plus an array of
+ * {@code nb_scores} floats, in the given AVFrame {@code frame} as
+ * AVFrameSideData of type AV_FRAME_DATA_CLASSIFICATION_SCORES and
+ * initializes the variables.
+ */
+AVClassificationScores *av_classification_scores_create_side_data(AVFrame *frame, uint32_t nb_scores);
+
+#endif
@@ -224,6 +224,12 @@ enum AVFrameSideDataType {
      * encoding.
      */
     AV_FRAME_DATA_VIDEO_HINT,
+
+    /**
+     * Per-class scores of a whole-frame classification. The data is an
+     * AVClassificationScores as defined in libavutil/classification_scores.h.
+     */
+    AV_FRAME_DATA_CLASSIFICATION_SCORES,
 };
 
 enum AVActiveFormatDescription {
@@ -0,0 +1,371 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale one source to several destinations
+ *
+ * Every destination is scaled either from the source or, when cascading is
+ * allowed, from the smallest other destination of the same format that is at
+ * least as large. A destination scaled from a larger one of a different size
+ * only reads that destination, and one of the same size as the source but in a
+ * different format shares the input conversion with all destinations
+ * cascaded from it.
+ *
+ * Single threaded scalers are run as a pipeline over horizontal bands of the
+ * source, so each band passes through all destinations that depend on it
+ * while it is still in the cache. Threaded scalers, and scalers which can
+ * not process slices, convert whole frames after the pipeline.
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "swscale.h"
+#include "swscale_internal.h"
+
+// number of source rows fed to the pipeline at once, a multiple of the
+// vertical subsampling of all formats
+#define BAND_HEIGHT 16
+
+typedef struct LadderDst {
+    int width, height;
+    enum AVPixelFormat format;
+
+    // index of the destination this one is scaled from, -1 for the source
+    int parent;
+    // scaled in the band pipeline
+    int streamed;
+
+    SwsContext *sws;
+
+    // per-frame state of the pipeline: rows written to the destination and
+    // rows of the parent already passed to the scaler
+    int rows_out;
+    int rows_in;
+} LadderDst;
+
+struct SwsLadder {
+    SwsContext *opts;
+    int         flags;
+
+    int src_w, src_h;
+    enum AVPixelFormat src_format;
+
+    LadderDst *dst;
+    int     nb_dst;
+    // destinations in the order they are computed, parents before children
+    int       *order;
+};
+
+SwsLadder *sws_ladder_alloc(const SwsContext *opts, int flags)
+{
+    SwsLadder *l = av_mallocz(sizeof(*l));
+    if (!l)
+        return NULL;
+
+    l->opts  = sws_alloc_context();
+    l->flags = flags;
+    if (!l->opts || (opts && av_opt_copy(l->opts, opts) < 0)) {
+        sws_ladder_free(&l);
+        return NULL;
+    }
+
+    return l;
+}
+
+static void ladder_reset(SwsLadder *l)
+{
+    for (int i = 0; i < l->nb_dst; i++)
+        sws_freeContext(l->dst[i].sws);
+    av_freep(&l->dst);
+    av_freep(&l->order);
+    l->nb_dst = 0;
+}
+
+void sws_ladder_free(SwsLadder **pl)
+{
+    SwsLadder *l = *pl;
+
+    if (!l)
+        return;
+
+    ladder_reset(l);
+    sws_freeContext(l->opts);
+
+    av_freep(pl);
+}
+
+static int64_t dst_area(const LadderDst *d)
+{
+    return (int64_t)d->width * d->height;
+}
+
+static int ladder_configured(const SwsLadder *l, AVFrame *const *dst, int nb_dst,
+                             const AVFrame *src)
+{
+    if (l->nb_dst != nb_dst || l->src_w != src->width || l->src_h != src->height ||
+        l->src_format != src->format)
+        return 0;
+
+    for (int i = 0; i < nb_dst; i++)
+        if (l->dst[i].width  != dst[i]->width  ||
+            l->dst[i].height != dst[i]->height ||
+            l->dst[i].format != dst[i]->format)
+            return 0;
+
+    return 1;
+}
+
+static int ladder_configure(SwsLadder *l, AVFrame *const *dst, int nb_dst,
+                            const AVFrame *src)
+{
+    int64_t dst_range, dst_h_chr_pos, dst_v_chr_pos;
+    int ret;
+
+    ladder_reset(l);
+
+    l->dst   = av_calloc(nb_dst, sizeof(*l->dst));
+    l->order = av_calloc(nb_dst, sizeof(*l->order));
+    if (!l->dst || !l->order)
+        return AVERROR(ENOMEM);
+    l->nb_dst = nb_dst;
+
+    l->src_w      = src->width;
+    l->src_h      = src->height;
+    l->src_format = src->format;
+
+    for (int i = 0; i < nb_dst; i++) {
+        LadderDst *d = &l->dst[i];
+
+        d->width  = dst[i]->width;
+        d->height = dst[i]->height;
+        d->format = dst[i]->format;
+
+        if (d->width <= 0 || d->height <= 0 ||
+            !sws_isSupportedOutput(d->format))
+            return AVERROR(EINVAL);
+    }
+
+    // pick the smallest other destination that is at least as large in both
+    // dimensions and has the same format; among destinations of the same size
+    // only earlier ones qualify, so the parents always form a tree
+    for (int i = 0; i < nb_dst; i++) {
+        LadderDst *d = &l->dst[i];
+        int64_t best_area = INT64_MAX;
+
+        d->parent = -1;
+
+        if (l->flags & SWS_LADDER_NO_CASCADE)
+            continue;
+
+        for (int j = 0; j < nb_dst; j++) {
+            const LadderDst *c = &l->dst[j];
+
+            if (j == i || c->format != d->format ||
+                c->width < d->width || c->height < d->height)
+                continue;
+            if (c->width == d->width && c->height == d->height && j > i)
+                continue;
+            // never upscale on the way
+            if (c->width > src->width || c->height > src->height)
+                continue;
+            // an exact copy of the source is not a better source
+            if (c->width == src->width && c->height == src->height &&
+                c->format == src->format)
+                continue;
+
+            if (dst_area(c) < best_area) {
+                best_area = dst_area(c);
+                d->parent = j;
+            }
+        }
+    }
+
+    // larger destinations first, stable for those of the same size
+    for (int i = 0; i < nb_dst; i++) {
+        int tmp = i, j;
+        for (j = i; j > 0 && dst_area(&l->dst[l->order[j - 1]]) < dst_area(&l->dst[tmp]); j--)
+            l->order[j] = l->order[j - 1];
+        l->order[j] = tmp;
+    }
+
+    // cascaded scalers read a destination, so they see its properties
+    ret = av_opt_get_int(l->opts, "dst_range", 0, &dst_range);
+    if (ret >= 0)
+        ret = av_opt_get_int(l->opts, "dst_h_chr_pos", 0, &dst_h_chr_pos);
+    if (ret >= 0)
+        ret = av_opt_get_int(l->opts, "dst_v_chr_pos", 0, &dst_v_chr_pos);
+    if (ret < 0)
+        return ret;
+
+    for (int k = 0; k < nb_dst; k++) {
+        LadderDst *d = &l->dst[l->order[k]];
+        const LadderDst *p = d->parent >= 0 ? &l->dst[d->parent] : NULL;
+
+        d->sws = sws_alloc_context();
+        if (!d->sws)
+            return AVERROR(ENOMEM);
+
+        ret = av_opt_copy(d->sws, l->opts);
+        if (ret < 0)
+            return ret;
+
+        av_opt_set_int(d->sws, "srcw",       p ? p->width  : src->width,  0);
+        av_opt_set_int(d->sws, "srch",       p ? p->height : src->height, 0);
+        av_opt_set_int(d->sws, "src_format", p ? p->format : src->format, 0);
+        av_opt_set_int(d->sws, "dstw",       d->width,  0);
+        av_opt_set_int(d->sws, "dsth",       d->height, 0);
+        av_opt_set_int(d->sws, "dst_format", d->format, 0);
+        if (p) {
+            av_opt_set_int(d->sws, "src_range",     dst_range,     0);
+            av_opt_set_int(d->sws, "src_h_chr_pos", dst_h_chr_pos, 0);
+            av_opt_set_int(d->sws, "src_v_chr_pos", dst_v_chr_pos, 0);
+        }
+
+        ret = sws_init_context(d->sws, NULL, NULL);
+        if (ret < 0)
+            return ret;
+
+        d->streamed = !d->sws->nb_slice_ctx && !d->sws->cascaded_context[0] &&
+                      (!p || p->streamed);
+    }
+
+    return 0;
+}
+
+static void plane_pointers(const AVFrame *f, int y, const uint8_t *data[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(f->format);
+
+    for (int i = 0; i < 4; i++) {
+        const int vshift = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+
+        // the palette is not part of the image
+        if (i == 1 && (desc->flags & AV_PIX_FMT_FLAG_PAL))
+            data[i] = f->data[i];
+        else
+            data[i] = f->data[i] ? f->data[i] + f->linesize[i] * (y >> vshift) : NULL;
+    }
+}
+
+/**
+ * Pass the rows [start, end) of the source of the given destination to its
+ * scaler, then the newly written rows to all destinations streamed from it.
+ */
+static int ladder_feed(SwsLadder *l, AVFrame *const *dst, const AVFrame *src,
+                       int idx, int start, int end)
+{
+    LadderDst *d = &l->dst[idx];
+    const uint8_t *slice[4];
+    int ret, rows_out;
+
+    plane_pointers(src, start, slice);
+
+    ret = sws_scale(d->sws, slice, src->linesize, start, end - start,
+                    dst[idx]->data, dst[idx]->linesize);
+    if (ret < 0)
+        return ret;
+
+    d->rows_in = end;
+    rows_out   = d->rows_out += ret;
+
+    for (int k = 0; k < l->nb_dst; k++) {
+        const int c = l->order[k];
+        const LadderDst *child = &l->dst[c];
+        int avail = rows_out;
+
+        if (child->parent != idx || !child->streamed)
+            continue;
+
+        // keep slices aligned to the subsampling until the last one
+        if (avail < d->height) {
+            const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(d->format);
+            avail &= ~((1 << desc->log2_chroma_h) - 1);
+        }
+        if (avail <= child->rows_in)
+            continue;
+
+        ret = ladder_feed(l, dst, dst[idx], c, child->rows_in, avail);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int sws_ladder_scale(SwsLadder *l, AVFrame *const *dst, int nb_dst,
+                     const AVFrame *src)
+{
+    int ret;
+
+    if (nb_dst <= 0)
+        return AVERROR(EINVAL);
+
+    if (!ladder_configured(l, dst, nb_dst, src)) {
+        ret = ladder_configure(l, dst, nb_dst, src);
+        if (ret < 0) {
+            ladder_reset(l);
+            return ret;
+        }
+    }
+
+    for (int i = 0; i < nb_dst; i++) {
+        l->dst[i].rows_out = 0;
+        l->dst[i].rows_in  = 0;
+
+        if (!dst[i]->buf[0]) {
+            ret = av_frame_get_buffer(dst[i], 0);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    for (int y = 0; y < src->height; y += BAND_HEIGHT) {
+        const int end = FFMIN(y + BAND_HEIGHT, src->height);
+
+        for (int k = 0; k < nb_dst; k++) {
+            const LadderDst *d = &l->dst[l->order[k]];
+
+            if (d->parent >= 0 || !d->streamed)
+                continue;
+
+            ret = ladder_feed(l, dst, src, l->order[k], y, end);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    for (int k = 0; k < nb_dst; k++) {
+        const int i = l->order[k];
+        const LadderDst *d = &l->dst[i];
+
+        if (d->streamed)
+            continue;
+
+        ret = sws_scale_frame(d->sws, dst[i], d->parent >= 0 ? dst[d->parent] : src);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
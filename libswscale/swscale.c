@@ -1109,6 +1109,33 @@ int sws_frame_start(struct SwsContext *c, AVFrame *dst, const AVFrame *src)
     return 0;
 }
 
+/**
+ * Scale the output rows [slice_start, slice_start + slice_height) of
+ * frame_src into frame_dst, split into bands over the slice threads.
+ */
+static int scale_threaded(SwsContext *c, unsigned int slice_start,
+                          unsigned int slice_height)
+{
+    int nb_jobs = c->slice_ctx[0]->dither == SWS_DITHER_ED ? 1 : c->nb_slice_ctx;
+    int ret = 0;
+
+    c->dst_slice_start  = slice_start;
+    c->dst_slice_height = slice_height;
+
+    avpriv_slicethread_execute(c->slicethread, nb_jobs, 0);
+
+    for (int i = 0; i < c->nb_slice_ctx; i++) {
+        if (c->slice_err[i] < 0) {
+            ret = c->slice_err[i];
+            break;
+        }
+    }
+
+    memset(c->slice_err, 0, c->nb_slice_ctx * sizeof(*c->slice_err));
+
+    return ret;
+}
+
 int sws_send_slice(struct SwsContext *c, unsigned int slice_start,
                    unsigned int slice_height)
 {
@@ -1149,26 +1176,8 @@ int sws_receive_slice(struct SwsContext *c, unsigned int slice_start,
         return AVERROR(EINVAL);
     }
 
-    if (c->slicethread) {
-        int nb_jobs = c->slice_ctx[0]->dither == SWS_DITHER_ED ? 1 : c->nb_slice_ctx;
-        int ret = 0;
-
-        c->dst_slice_start  = slice_start;
-        c->dst_slice_height = slice_height;
-
-        avpriv_slicethread_execute(c->slicethread, nb_jobs, 0);
-
-        for (int i = 0; i < c->nb_slice_ctx; i++) {
-            if (c->slice_err[i] < 0) {
-                ret = c->slice_err[i];
-                break;
-            }
-        }
-
-        memset(c->slice_err, 0, c->nb_slice_ctx * sizeof(*c->slice_err));
-
-        return ret;
-    }
+    if (c->slicethread)
+        return scale_threaded(c, slice_start, slice_height);
 
     for (int i = 0; i < FF_ARRAY_ELEMS(dst); i++) {
         ptrdiff_t offset = c->frame_dst->linesize[i] * (slice_start >> c->chrDstVSubSample);
@@ -1207,8 +1216,36 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
                                   int srcSliceH, uint8_t *const dst[],
                                   const int dstStride[])
 {
-    if (c->nb_slice_ctx)
-        c = c->slice_ctx[0];
+    if (c->nb_slice_ctx) {
+        int ret;
+
+        /* a slice of the input can only be scaled by a single context, but
+         * complete frames are split over the slice threads like in
+         * sws_scale_frame() */
+        if (srcSliceY || srcSliceH != c->srcH || c->frame_src->buf[0])
+            return scale_internal(c->slice_ctx[0], srcSlice, srcStride,
+                                  srcSliceY, srcSliceH, dst, dstStride,
+                                  0, c->slice_ctx[0]->dstH);
+
+        if (!srcSlice || !srcStride || !dst || !dstStride) {
+            av_log(c, AV_LOG_ERROR, "One of the input parameters to sws_scale() is NULL, please check the calling code\n");
+            return AVERROR(EINVAL);
+        }
+
+        for (int i = 0; i < 4; i++) {
+            c->frame_src->data[i]     = (uint8_t *)srcSlice[i];
+            c->frame_src->linesize[i] = srcStride[i];
+            c->frame_dst->data[i]     = dst[i];
+            c->frame_dst->linesize[i] = dstStride[i];
+        }
+
+        ret = scale_threaded(c, 0, c->dstH);
+
+        av_frame_unref(c->frame_src);
+        av_frame_unref(c->frame_dst);
+
+        return ret < 0 ? ret : c->dstH;
+    }
 
     return scale_internal(c, srcSlice, srcStride, srcSliceY, srcSliceH,
                           dst, dstStride, 0, c->dstH);
@@ -325,6 +325,61 @@ int sws_receive_slice(struct SwsContext *c, unsigned int slice_start,
  */
 unsigned int sws_receive_slice_alignment(const struct SwsContext *c);
 
+/**
+ * Context for scaling one source to several destinations, see
+ * sws_ladder_scale().
+ */
+typedef struct SwsLadder SwsLadder;
+
+/**
+ * Scale every destination from the source, instead of cascading from larger
+ * destinations.
+ */
+#define SWS_LADDER_NO_CASCADE (1 << 0)
+
+/**
+ * Allocate a context for scaling one source to several destinations.
+ *
+ * @param opts  scaling context whose options (e.g. sws_flags, threads,
+ *              dst_range) are used for all destinations; the source and
+ *              destination dimensions and formats set in it are ignored.
+ *              May be NULL for the defaults. It is not referenced after this
+ *              call returns.
+ * @param flags a combination of SWS_LADDER_* flags
+ * @return the new context or NULL on failure
+ */
+SwsLadder *sws_ladder_alloc(const struct SwsContext *opts, int flags);
+
+/**
+ * Free the context and everything associated with it, and write NULL to
+ * the provided pointer.
+ */
+void sws_ladder_free(SwsLadder **ladder);
+
+/**
+ * Scale the source to all destinations in one pass over the source.
+ *
+ * Each destination is scaled from the smallest other destination of the same
+ * pixel format that is at least as large in both dimensions, unless
+ * SWS_LADDER_NO_CASCADE was set, so the source is only read by the scalers of
+ * the largest destinations. With single threaded scalers, destinations that
+ * are scaled from the source are processed band by band together with the
+ * destinations that depend on them, so that each part of the source is read
+ * only once while it is in the cache. Threaded scalers convert whole frames.
+ *
+ * The scalers are set up on the first call and set up again whenever the
+ * source or destination properties change.
+ *
+ * @param ladder the context
+ * @param dst    nb_dst destination frames with width, height and format set;
+ *               frames without buffers are allocated, as in sws_frame_start()
+ * @param nb_dst number of destinations
+ * @param src    the source frame
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int sws_ladder_scale(SwsLadder *ladder, AVFrame *const *dst, int nb_dst,
+                     const AVFrame *src);
+
 /**
  * @param c the scaling context
  * @param dstRange flag indicating the while-black range of the output (1=jpeg / 0=mpeg)
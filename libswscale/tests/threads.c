@@ -0,0 +1,199 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that sws_scale() on complete frames gives the same output when the
+ * frame is split over several slice threads as with a single thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+
+static const struct {
+    enum AVPixelFormat src_fmt, dst_fmt;
+    int flags;
+} tests[] = {
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P, SWS_BICUBIC | SWS_ACCURATE_RND },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_RGB24,   SWS_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_NV12,    SWS_LANCZOS  },
+    { AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV444P, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV420P, SWS_BICUBIC | SWS_ACCURATE_RND },
+    { AV_PIX_FMT_RGB24,       AV_PIX_FMT_YUV420P, SWS_AREA     },
+    { AV_PIX_FMT_BGRA,        AV_PIX_FMT_YUVA420P, SWS_FAST_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_RGB8,    SWS_BICUBIC | SWS_FULL_CHR_H_INT },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_P010LE,  SWS_SPLINE   },
+};
+
+/* odd sizes, so that neither the frames nor the bands divide evenly */
+static const int sizes[][4] = {
+    { 173,  99,  64,  37 },
+    {  97,  33, 211, 121 },
+    { 320, 241, 320, 241 },
+    {  62,  17,  62,   3 },
+};
+
+static const int thread_counts[] = { 2, 3, 4, 7 };
+
+static struct SwsContext *alloc_context(int src_w, int src_h, enum AVPixelFormat src_fmt,
+                                        int dst_w, int dst_h, enum AVPixelFormat dst_fmt,
+                                        int flags, int threads)
+{
+    struct SwsContext *c = sws_alloc_context();
+
+    if (!c)
+        return NULL;
+
+    av_opt_set_int(c, "srcw",       src_w,   0);
+    av_opt_set_int(c, "srch",       src_h,   0);
+    av_opt_set_int(c, "src_format", src_fmt, 0);
+    av_opt_set_int(c, "dstw",       dst_w,   0);
+    av_opt_set_int(c, "dsth",       dst_h,   0);
+    av_opt_set_int(c, "dst_format", dst_fmt, 0);
+    av_opt_set_int(c, "sws_flags",  flags | SWS_BITEXACT, 0);
+    av_opt_set_int(c, "threads",    threads, 0);
+
+    if (sws_init_context(c, NULL, NULL) < 0) {
+        sws_freeContext(c);
+        return NULL;
+    }
+    return c;
+}
+
+/* compare the visible part of two images */
+static int compare_images(uint8_t *const a[4], const int a_linesize[4],
+                          uint8_t *const b[4], const int b_linesize[4],
+                          enum AVPixelFormat fmt, int w, int h)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+
+    for (int p = 0; p < av_pix_fmt_count_planes(fmt); p++) {
+        int plane_h = p == 1 || p == 2 ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+        int bytes   = av_image_get_linesize(fmt, w, p);
+
+        for (int y = 0; y < plane_h; y++)
+            if (memcmp(a[p] + y * a_linesize[p], b[p] + y * b_linesize[p], bytes))
+                return 1;
+    }
+    return 0;
+}
+
+static int run_test(AVLFG *lfg, int t, const int *size)
+{
+    enum AVPixelFormat src_fmt = tests[t].src_fmt, dst_fmt = tests[t].dst_fmt;
+    int src_w = size[0], src_h = size[1], dst_w = size[2], dst_h = size[3];
+    uint8_t *src[4], *ref[4], *dst[4];
+    int src_linesize[4], ref_linesize[4], dst_linesize[4];
+    struct SwsContext *c;
+    int ret, src_size, nb_fail = 0;
+
+    src_size = av_image_alloc(src, src_linesize, src_w, src_h, src_fmt, 16);
+    if (src_size < 0)
+        return src_size;
+    /* random data, including the high bits of the high depth formats */
+    for (int i = 0; i < src_size; i++)
+        src[0][i] = av_lfg_get(lfg);
+
+    ret = av_image_alloc(ref, ref_linesize, dst_w, dst_h, dst_fmt, 16);
+    if (ret < 0) {
+        av_freep(&src[0]);
+        return ret;
+    }
+    ret = av_image_alloc(dst, dst_linesize, dst_w, dst_h, dst_fmt, 16);
+    if (ret < 0) {
+        av_freep(&src[0]);
+        av_freep(&ref[0]);
+        return ret;
+    }
+
+    c = alloc_context(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt, tests[t].flags, 1);
+    if (!c) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    ret = sws_scale(c, (const uint8_t *const *)src, src_linesize, 0, src_h, ref, ref_linesize);
+    sws_freeContext(c);
+    if (ret != dst_h) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(thread_counts); i++) {
+        c = alloc_context(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt,
+                          tests[t].flags, thread_counts[i]);
+        if (!c) {
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        /* clobber the output so that rows not written are caught too */
+        memset(dst[0], 0xAA, av_image_get_buffer_size(dst_fmt, dst_w, dst_h, 16));
+        ret = sws_scale(c, (const uint8_t *const *)src, src_linesize, 0, src_h, dst, dst_linesize);
+        sws_freeContext(c);
+
+        if (ret != dst_h ||
+            compare_images(ref, ref_linesize, dst, dst_linesize, dst_fmt, dst_w, dst_h)) {
+            printf("%s %dx%d -> %s %dx%d, %d threads: mismatch\n",
+                   av_get_pix_fmt_name(src_fmt), src_w, src_h,
+                   av_get_pix_fmt_name(dst_fmt), dst_w, dst_h, thread_counts[i]);
+            nb_fail++;
+        }
+    }
+    ret = nb_fail;
+
+end:
+    av_freep(&src[0]);
+    av_freep(&ref[0]);
+    av_freep(&dst[0]);
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG lfg;
+    int nb_fail = 0;
+
+    av_lfg_init(&lfg, 0xC0FFEE);
+
+    for (int t = 0; t < FF_ARRAY_ELEMS(tests); t++) {
+        int fail = 0;
+
+        for (int s = 0; s < FF_ARRAY_ELEMS(sizes); s++) {
+            int ret = run_test(&lfg, t, sizes[s]);
+
+            if (ret < 0) {
+                fprintf(stderr, "Failed to scale %s to %s\n",
+                        av_get_pix_fmt_name(tests[t].src_fmt),
+                        av_get_pix_fmt_name(tests[t].dst_fmt));
+                return 1;
+            }
+            fail += ret;
+        }
+        printf("%s -> %s: %s\n", av_get_pix_fmt_name(tests[t].src_fmt),
+               av_get_pix_fmt_name(tests[t].dst_fmt), fail ? "FAIL" : "OK");
+        nb_fail += fail;
+    }
+
+    return !!nb_fail;
+}
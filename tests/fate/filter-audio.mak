@@ -214,6 +214,31 @@ FATE_AFILTER-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FIL
 fate-filter-hls: tests/data/hls-list.m3u8
 fate-filter-hls: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/hls-list.m3u8 -af aresample
 
+FATE_AFILTER-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-filter-hls-prefetch
+fate-filter-hls-prefetch: tests/data/hls-list.m3u8
+fate-filter-hls-prefetch: CMD = framecrc -flags +bitexact -prefetch_segments 2 -i $(TARGET_PATH)/tests/data/hls-list.m3u8 -af aresample
+fate-filter-hls-prefetch: REF = $(SRC_PATH)/tests/ref/fate/filter-hls
+
+# two variant playlists with AES-128 encrypted segments, both read at once
+tests/data/hls-multi.m3u8: TAG = GEN
+tests/data/hls-multi.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f lavfi -i "aevalsrc=sin(2*PI*(220+8*t)*t):d=20" \
+        -map 0 -map 1 -flags +bitexact -codec:a mp2fixed -f hls -hls_time 3 -hls_list_size 0 -var_stream_map "a:0 a:1" \
+        -hls_enc 1 -hls_enc_key 00112233445566778899aabbccddeeff -hls_enc_iv 0123456789abcdef0123456789abcdef \
+        -master_pl_name hls-multi.m3u8 -hls_segment_filename $(TARGET_PATH)/tests/data/hls-multi-%v-%03d.ts \
+        -y $(TARGET_PATH)/tests/data/hls-multi-%v.m3u8 2>/dev/null
+
+FATE_AFILTER-$(call ALLYES, HLS_DEMUXER HLS_MUXER MPEGTS_MUXER MPEGTS_DEMUXER CRYPTO_PROTOCOL AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-filter-hls-multi
+fate-filter-hls-multi: tests/data/hls-multi.m3u8
+fate-filter-hls-multi: CMD = framecrc -flags +bitexact -allowed_extensions ALL -i $(TARGET_PATH)/tests/data/hls-multi.m3u8 -map 0 -af aresample
+
+# the prefetch thread serves both playlists, the output must not change
+FATE_AFILTER-$(call ALLYES, HLS_DEMUXER HLS_MUXER MPEGTS_MUXER MPEGTS_DEMUXER CRYPTO_PROTOCOL AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-filter-hls-multi-prefetch
+fate-filter-hls-multi-prefetch: tests/data/hls-multi.m3u8
+fate-filter-hls-multi-prefetch: CMD = framecrc -flags +bitexact -allowed_extensions ALL -prefetch_segments 2 -i $(TARGET_PATH)/tests/data/hls-multi.m3u8 -map 0 -af aresample
+fate-filter-hls-multi-prefetch: REF = $(SRC_PATH)/tests/ref/fate/filter-hls-multi
+
 tests/data/hls-list-append.m3u8: TAG = GEN
 tests/data/hls-list-append.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
@@ -327,6 +327,9 @@ fate-filter-untile: CMD = framecrc -lavfi testsrc2=d=1:r=2,untile=2x2
 FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 UNTILE) += fate-filter-untile-yuv422p
 fate-filter-untile-yuv422p: CMD = framecrc -lavfi testsrc2=d=1:r=2,format=yuv422p,untile=2x2
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 SCALELADDER) += fate-filter-scaleladder
+fate-filter-scaleladder: CMD = framecrc -lavfi "testsrc2=d=1:r=5,scaleladder=sizes=240x180|-2x90|120x90|320x240:flags=bicubic+accurate_rnd+bitexact"
+
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_UNSHARP_FILTER) += fate-filter-unsharp
 fate-filter-unsharp: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf unsharp=11:11:-1.5:11:11:-1.5
 
@@ -753,6 +756,16 @@ FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SPLIT_FILTER AVGBLUR_FILTER        \
                            METADATA_FILTER WRAPPED_AVFRAME_ENCODER NULL_MUXER \
                            PIPE_PROTOCOL) += $(FATE_FILTER_REFCMP_METADATA-yes)
 
+FATE_FILTER-$(call ALLYES, TESTSRC_FILTER TESTSRC2_FILTER TRIM_FILTER HFLIP_FILTER \
+                           SIGNATURE_FILTER NULLSINK_FILTER) += fate-filter-signature-bymem
+fate-filter-signature-bymem: libavfilter/tests/signature$(EXESUF)
+fate-filter-signature-bymem: CMD = run libavfilter/tests/signature$(EXESUF) $(TARGET_PATH)/tests/data/fate/filter-signature-bymem.bin
+
+FATE_FILTER-$(call ALLYES, TESTSRC_FILTER TRIM_FILTER SENDCMD_FILTER \
+                           SIGNATURE_FILTER NULLSINK_FILTER) += fate-filter-signature-segments
+fate-filter-signature-segments: libavfilter/tests/signature$(EXESUF)
+fate-filter-signature-segments: CMD = run libavfilter/tests/signature$(EXESUF) $(TARGET_PATH)/tests/data/fate/filter-signature-segments.bin segments
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
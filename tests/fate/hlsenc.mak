@@ -85,6 +85,98 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-list-size: tests/data/hls_list_size.m3u8
 fate-hls-list-size: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_list_size.m3u8 -vf setpts=N*23
 
+tests/data/hls_incremental_playlist.m3u8: TAG = GEN
+tests/data/hls_incremental_playlist.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f hls -hls_time 3 -map 0 \
+	-hls_flags incremental_playlist -hls_list_size 0 -codec:a mp2fixed \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_incremental_playlist_%d.ts \
+	$(TARGET_PATH)/tests/data/hls_incremental_playlist.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-incremental-playlist
+fate-hls-incremental-playlist: tests/data/hls_incremental_playlist.m3u8
+fate-hls-incremental-playlist: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_incremental_playlist.m3u8 -vf setpts=N*23
+
+# The same stream is written with and without incremental_playlist, with the
+# same segment names. Both playlists must match the same reference.
+# The long GOP of the fourth segment raises the target duration, which makes
+# the incremental writer rewrite the whole playlist once.
+tests/data/hls_incremental_list.m3u8: TAG = GEN
+tests/data/hls_incremental_list.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i testsrc=d=12:s=64x48:r=10 -map 0 -codec:v mpeg2video -g 200 -force_key_frames 0,1,2,3,8,9,10 \
+	-f hls -hls_time 1 -hls_list_size 0 -flags +bitexact \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_incremental_list_%d.ts \
+	-y $(TARGET_PATH)/$@ 2>/dev/null; \
+	mv $(TARGET_PATH)/$@ $(TARGET_PATH)/tests/data/hls_incremental_list_full.m3u8; \
+	$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i testsrc=d=12:s=64x48:r=10 -map 0 -codec:v mpeg2video -g 200 -force_key_frames 0,1,2,3,8,9,10 \
+	-f hls -hls_time 1 -hls_flags incremental_playlist -hls_list_size 0 -flags +bitexact \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_incremental_list_%d.ts \
+	-y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MPEGTS_MUXER TESTSRC_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER) += fate-hls-incremental-list
+fate-hls-incremental-list: tests/data/hls_incremental_list.m3u8
+fate-hls-incremental-list: CMD = cat $(TARGET_PATH)/tests/data/hls_incremental_list.m3u8
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MPEGTS_MUXER TESTSRC_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER) += fate-hls-incremental-list-full
+fate-hls-incremental-list-full: tests/data/hls_incremental_list.m3u8
+fate-hls-incremental-list-full: CMD = cat $(TARGET_PATH)/tests/data/hls_incremental_list_full.m3u8
+fate-hls-incremental-list-full: REF = $(SRC_PATH)/tests/ref/fate/hls-incremental-list
+
+# sliding window, incremental_playlist must not change anything here
+tests/data/hls_incremental_window.m3u8: TAG = GEN
+tests/data/hls_incremental_window.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f hls -hls_time 2 -map 0 \
+	-hls_flags delete_segments -hls_list_size 3 -codec:a mp2fixed -flags +bitexact \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_incremental_window_%d.ts \
+	-y $(TARGET_PATH)/$@ 2>/dev/null; \
+	mv $(TARGET_PATH)/$@ $(TARGET_PATH)/tests/data/hls_incremental_window_full.m3u8; \
+	$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f hls -hls_time 2 -map 0 \
+	-hls_flags delete_segments+incremental_playlist -hls_list_size 3 -codec:a mp2fixed -flags +bitexact \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_incremental_window_%d.ts \
+	-y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MPEGTS_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-incremental-window
+fate-hls-incremental-window: tests/data/hls_incremental_window.m3u8
+fate-hls-incremental-window: CMD = cat $(TARGET_PATH)/tests/data/hls_incremental_window.m3u8
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MPEGTS_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-incremental-window-full
+fate-hls-incremental-window-full: tests/data/hls_incremental_window.m3u8
+fate-hls-incremental-window-full: CMD = cat $(TARGET_PATH)/tests/data/hls_incremental_window_full.m3u8
+fate-hls-incremental-window-full: REF = $(SRC_PATH)/tests/ref/fate/hls-incremental-window
+
+tests/data/hls_part_time.m3u8: TAG = GEN
+tests/data/hls_part_time.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=5" -map 0 -codec:a mp2fixed \
+	-hls_segment_type fmp4 -hls_fmp4_init_filename hls_part_time_init.mp4 -hls_list_size 0 \
+	-hls_time 2 -hls_part_time 0.5 -hls_segment_filename "$(TARGET_PATH)/tests/data/hls_part_time_%d.m4s" \
+	$(TARGET_PATH)/tests/data/hls_part_time.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER HLS_DEMUXER MOV_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV \
+                            MP2FIXED_ENCODER MP3_DECODER PCM_S16LE_ENCODER) += fate-hls-part-time
+fate-hls-part-time: tests/data/hls_part_time.m3u8
+fate-hls-part-time: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_part_time.m3u8 -vf setpts=N*23
+
+# Every version of a LL-HLS playlist, written to stdout: partial segments
+# with their numbering and INDEPENDENT flags, EXT-X-PRELOAD-HINT,
+# EXT-X-SERVER-CONTROL with PART-HOLD-BACK and the partial segments dropped
+# from segments older than three target durations.
+tests/data/hls_low_latency.txt: TAG = GEN
+tests/data/hls_low_latency.txt: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)cd $(TARGET_PATH)/tests/data && $(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i testsrc=d=5:s=64x48:r=20 -map 0 -codec:v mpeg2video -g 10 -flags +bitexact \
+	-f hls -hls_segment_type fmp4 -hls_time 1 -hls_part_time 0.25 -hls_list_size 4 -hls_flags delete_segments \
+	-hls_fmp4_init_filename hls_low_latency_init.mp4 -hls_segment_filename hls_low_latency_%d.m4s \
+	pipe:1 > $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MOV_MUXER PIPE_PROTOCOL TESTSRC_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER) += fate-hls-low-latency
+fate-hls-low-latency: tests/data/hls_low_latency.txt
+fate-hls-low-latency: CMD = cat $(TARGET_PATH)/tests/data/hls_low_latency.txt
+
 tests/data/hls_fmp4.m3u8: TAG = GEN
 tests/data/hls_fmp4.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
@@ -6,6 +6,10 @@ FATE_LIBSWSCALE += fate-sws-floatimg-cmp
 fate-sws-floatimg-cmp: libswscale/tests/floatimg_cmp$(EXESUF)
 fate-sws-floatimg-cmp: CMD = run libswscale/tests/floatimg_cmp$(EXESUF)
 
+FATE_LIBSWSCALE += fate-sws-threads
+fate-sws-threads: libswscale/tests/threads$(EXESUF)
+fate-sws-threads: CMD = run libswscale/tests/threads$(EXESUF)
+
 SWS_SLICE_TEST-$(call DEMDEC, MATROSKA, VP9) += fate-sws-slice-yuv422-12bit-rgb48
 fate-sws-slice-yuv422-12bit-rgb48: CMD = run tools/scale_slice_test$(EXESUF) $(TARGET_SAMPLES)/vp9-test-vectors/vp93-2-20-12bit-yuv422.webm 150 100 rgb48
 
@@ -33,6 +37,20 @@ fate-sws-yuv-range: CMD = framecrc \
   -frames 1 \
   -vf scale=in_color_matrix=bt601:in_range=limited:out_color_matrix=bt601:out_range=full:flags=+accurate_rnd+bitexact
 
+# odd width and height, the last chroma sample of each line covers one pixel
+SWS_ODD_SRC = testsrc2=s=64x48:d=0.08,format=yuv420p10
+SWS_ODD_CROP = crop=33:17:0:0:exact=1
+
+FATE_LIBSWSCALE-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER CROP_FILTER \
+                                SCALE_FILTER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-sws-yuv420p10-p010-odd
+fate-sws-yuv420p10-p010-odd: CMD = framecrc -f lavfi -i $(SWS_ODD_SRC),$(SWS_ODD_CROP) \
+  -vf scale=flags=bitexact,format=p010
+
+FATE_LIBSWSCALE-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER CROP_FILTER \
+                                SCALE_FILTER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-sws-p010-yuv420p10-odd
+fate-sws-p010-yuv420p10-odd: CMD = framecrc -f lavfi -i $(SWS_ODD_SRC),format=p010,$(SWS_ODD_CROP) \
+  -vf scale=flags=bitexact,format=yuv420p10
+
 FATE_LIBSWSCALE += $(FATE_LIBSWSCALE-yes)
 FATE_LIBSWSCALE_SAMPLES += $(FATE_LIBSWSCALE_SAMPLES-yes)
 FATE-$(CONFIG_SWSCALE) += $(FATE_LIBSWSCALE)
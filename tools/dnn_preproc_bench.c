@@ -0,0 +1,153 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Time the per-frame preprocessing of the livepeer_dnn filter: the scale
+ * to the model size, and the normalization into the float input tensor as
+ * done before (a GRAY8 to GRAYF32 scale context built for every frame) and
+ * now (a plain loop), next to a scale straight to planar floats.
+ *
+ * make tools/dnn_preproc_bench
+ * tools/dnn_preproc_bench [WxH of the input] [WxH of the model] [number of frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "libswscale/swscale.h"
+
+static void fill_frame(AVFrame *frame)
+{
+    for (int p = 0; p < 3; p++) {
+        int w = p ? AV_CEIL_RSHIFT(frame->width,  1) : frame->width;
+        int h = p ? AV_CEIL_RSHIFT(frame->height, 1) : frame->height;
+
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+                frame->data[p][y * frame->linesize[p] + x] = x * 7 + y * 3 + p * 64;
+    }
+}
+
+static void normalize(const AVFrame *frame, float *dst)
+{
+    const uint8_t *src = frame->data[0];
+    const int len = frame->width * 3;
+
+    for (int y = 0; y < frame->height; y++) {
+        for (int x = 0; x < len; x++)
+            dst[x] = src[x] * (1.0f / 255.0f);
+        src += frame->linesize[0];
+        dst += len;
+    }
+}
+
+static int normalize_sws(const AVFrame *frame, float *dst)
+{
+    struct SwsContext *sws = sws_getContext(frame->width * 3, frame->height, AV_PIX_FMT_GRAY8,
+                                            frame->width * 3, frame->height, AV_PIX_FMT_GRAYF32,
+                                            0, NULL, NULL, NULL);
+    if (!sws)
+        return -1;
+    sws_scale(sws, (const uint8_t **)frame->data, frame->linesize, 0, frame->height,
+              (uint8_t *const *)&dst, (const int[4]){ frame->width * 3 * sizeof(float) });
+    sws_freeContext(sws);
+    return 0;
+}
+
+static void report(const char *name, int64_t elapsed, int nb_frames)
+{
+    printf("%-30s %9.1f us per frame\n", name, (double)elapsed / nb_frames);
+}
+
+int main(int argc, char **argv)
+{
+    const char *in_size    = argc > 1 ? argv[1] : "1920x1080";
+    const char *model_size = argc > 2 ? argv[2] : "224x224";
+    int nb_frames          = argc > 3 ? atoi(argv[3]) : 300;
+    struct SwsContext *rgb_scale = NULL, *float_scale = NULL;
+    AVFrame *in = av_frame_alloc(), *scaled = av_frame_alloc(), *planar = av_frame_alloc();
+    float *tensor = NULL;
+    int64_t start;
+    int w, h, mw, mh, ret = 1;
+
+    if (av_parse_video_size(&w, &h, in_size) < 0 ||
+        av_parse_video_size(&mw, &mh, model_size) < 0 || nb_frames <= 0) {
+        fprintf(stderr, "Usage: %s [WxH of the input] [WxH of the model] [number of frames]\n",
+                argv[0]);
+        goto end;
+    }
+    if (!in || !scaled || !planar)
+        goto end;
+
+    in->format     = AV_PIX_FMT_YUV420P;
+    in->width      = w;
+    in->height     = h;
+    scaled->format = AV_PIX_FMT_RGB24;
+    scaled->width  = mw;
+    scaled->height = mh;
+    planar->format = AV_PIX_FMT_GBRPF32;
+    planar->width  = mw;
+    planar->height = mh;
+    tensor = av_malloc_array(mw * 3, mh * sizeof(*tensor));
+    rgb_scale   = sws_getContext(w, h, in->format, mw, mh, scaled->format,
+                                 SWS_BILINEAR, NULL, NULL, NULL);
+    float_scale = sws_getContext(w, h, in->format, mw, mh, planar->format,
+                                 SWS_BILINEAR, NULL, NULL, NULL);
+    if (!tensor || !rgb_scale || !float_scale ||
+        av_frame_get_buffer(in, 0) < 0 || av_frame_get_buffer(scaled, 0) < 0 ||
+        av_frame_get_buffer(planar, 0) < 0)
+        goto end;
+    fill_frame(in);
+
+    start = av_gettime_relative();
+    for (int i = 0; i < nb_frames; i++)
+        sws_scale(rgb_scale, (const uint8_t **)in->data, in->linesize, 0, h,
+                  scaled->data, scaled->linesize);
+    report("sws_scale to RGB24", av_gettime_relative() - start, nb_frames);
+
+    start = av_gettime_relative();
+    for (int i = 0; i < nb_frames; i++)
+        if (normalize_sws(scaled, tensor) < 0)
+            goto end;
+    report("normalize, sws per frame (old)", av_gettime_relative() - start, nb_frames);
+
+    start = av_gettime_relative();
+    for (int i = 0; i < nb_frames; i++)
+        normalize(scaled, tensor);
+    report("normalize, loop (new)", av_gettime_relative() - start, nb_frames);
+
+    start = av_gettime_relative();
+    for (int i = 0; i < nb_frames; i++)
+        sws_scale(float_scale, (const uint8_t **)in->data, in->linesize, 0, h,
+                  planar->data, planar->linesize);
+    report("sws_scale to GBRPF32", av_gettime_relative() - start, nb_frames);
+
+    ret = 0;
+end:
+    sws_freeContext(rgb_scale);
+    sws_freeContext(float_scale);
+    av_frame_free(&in);
+    av_frame_free(&scaled);
+    av_frame_free(&planar);
+    av_free(tensor);
+    return ret;
+}
@@ -0,0 +1,141 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Pass packets between two threads through the ffmpeg CLI thread queue,
+ * once with the locked and once with the lock-free implementation.
+ *
+ * make tools/thread_queue_bench
+ * tools/thread_queue_bench [number of packets] [queue size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/packet.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "fftools/objpool.h"
+#include "fftools/thread_queue.h"
+
+typedef struct BenchContext {
+    ThreadQueue *tq;
+    int nb_packets;
+    int error;
+} BenchContext;
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static void *producer(void *arg)
+{
+    BenchContext *b = arg;
+    AVPacket *pkt = av_packet_alloc();
+
+    if (!pkt) {
+        b->error = 1;
+        return NULL;
+    }
+
+    for (int i = 0; i < b->nb_packets; i++) {
+        pkt->pts = i;
+        if (tq_send(b->tq, 0, pkt) < 0) {
+            b->error = 1;
+            break;
+        }
+    }
+    tq_send_finish(b->tq, 0);
+
+    av_packet_free(&pkt);
+    return NULL;
+}
+
+static int run(int nb_packets, int queue_size, int flags)
+{
+    BenchContext b = { .nb_packets = nb_packets };
+    AVPacket *pkt = av_packet_alloc();
+    ObjPool *op = objpool_alloc_packets();
+    pthread_t thread;
+    int64_t start, elapsed;
+    int stream_idx, received = 0, ret;
+
+    if (!pkt || !op)
+        goto fail;
+
+    b.tq = tq_alloc(1, queue_size, op, pkt_move, flags);
+    if (!b.tq)
+        goto fail;
+    op = NULL;
+
+    start = av_gettime_relative();
+    if (pthread_create(&thread, NULL, producer, &b))
+        goto fail;
+
+    while ((ret = tq_receive(b.tq, &stream_idx, pkt)) >= 0) {
+        if (pkt->pts != received++)
+            b.error = 1;
+        av_packet_unref(pkt);
+    }
+    pthread_join(thread, NULL);
+    elapsed = av_gettime_relative() - start;
+
+    if (b.error || received != nb_packets) {
+        fprintf(stderr, "%s: %d of %d packets received\n",
+                flags ? "spsc" : "locked", received, nb_packets);
+        goto fail;
+    }
+
+    printf("%-6s queue size %4d: %8.1f ns per packet\n", flags ? "spsc" : "locked",
+           queue_size, elapsed * 1000.0 / nb_packets);
+
+    tq_free(&b.tq);
+    av_packet_free(&pkt);
+    return 0;
+fail:
+    tq_free(&b.tq);
+    objpool_free(&op);
+    av_packet_free(&pkt);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_packets = argc > 1 ? atoi(argv[1]) : 1000000;
+    int queue_size = argc > 2 ? atoi(argv[2]) : 0;
+    static const int sizes[] = { 1, 8, 64 };
+
+    if (nb_packets <= 0 || queue_size < 0) {
+        fprintf(stderr, "Usage: %s [number of packets] [queue size]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        int size = queue_size ? queue_size : sizes[i];
+
+        if (run(nb_packets, size, 0) ||
+            run(nb_packets, size, TQ_SINGLE_PRODUCER_CONSUMER))
+            return 1;
+        if (queue_size)
+            break;
+    }
+
+    return 0;
+}